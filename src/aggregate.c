@@ -0,0 +1,258 @@
+/*
+ *	aggregate.c
+ *
+ *	Count, minimum, maximum, sum and distinct count of the values at a
+ *	path, in constant memory.
+ */
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	<string.h>
+# include	<ctype.h>
+# include	<limits.h>
+# include	<math.h>
+# include	"stricmp.h"
+# include	"berval.h"
+# include	"hash64.h"
+# include	"aggregate.h"
+
+static void		 AddHash (Aggregate *, hash64);
+static int		 Compare (const byte *, long, const byte *, long);
+static void		 PrintString (FILE *, const byte *, long);
+static void		 SetString (byte *, long *, const byte *, long);
+
+
+/*:>* aggregate.c ***********************************************************
+
+Name
+	agParse
+
+Info
+	Aggregate the values at a path
+
+Syntax
+	int agParse (Aggregate *ag, const char *path, long length);
+	int agMatch (const Aggregate *ag, int depth, int cl, long tag);
+	void agAdd (Aggregate *ag, int cl, long tag, const byte *content, long length);
+	double agDistinct (const Aggregate *ag);
+	void agPrint (const Aggregate *ag, FILE *fp);
+
+Include
+	aggregate.h
+
+Description
+	`agParse()` sets up `ag` for the `length` characters at `path`, e.g.
+	"A[1]/C[5]" or "A[1]/C[2]:str". The components are the tags of the
+	top-level element and its descendants, written as in the dump with
+	the first letter of the class; "*" takes any tag. A suffix ":int" or
+	":str" tells the type of the values. Without it universal INTEGER and
+	ENUMERATED values and other primitives of 1 to 8 bytes are integers.$
+	`agMatch()` tells whether an element of class `cl` and number `tag`
+	matches the component `depth` (0 for the top-level element) of `ag`.$
+	`agAdd()` adds the `length` bytes at `content` of a matching element.
+	Integers which fit into a long are summed, and their minimum and
+	maximum are kept. When the sum overflows a long, `overflow` is set
+	and the sum is no longer kept. Other values are compared byte by
+	byte, only their first agMAXSTRING bytes are kept for that. All
+	values are counted in a HyperLogLog sketch of 2^agHLLBITS registers,
+	so the memory doesn't grow with the input.$
+	`agDistinct()` estimates the number of distinct values, with a
+	standard error of about 1.6%.$
+	`agPrint()` writes the aggregates to `fp` in one line.
+
+Return value
+	`agParse()` returns 0 or -1 if the path isn't valid. `agMatch()`
+	returns 1 if the element matches, otherwise 0.
+
+Example
+	% agParse (&ag, "A[1]/C[5]", 9);
+	% ...
+	% if (depth == 1 && agMatch (&ag, 0, cl0, tag0) && agMatch (&ag, 1, cl, tag))
+	%	agAdd (&ag, cl, tag, content, length);
+	% ...
+	% agPrint (&ag, stdout);
+
+**************************************************************************<:*/
+
+int agParse (Aggregate *ag, const char *path, long length) {
+	static const char	 classes[]= "UACP";
+	char		 buf[sizeof(ag->path)],
+				*p,
+				*q,
+				*e,
+				*c;
+
+	memset (ag, 0, sizeof(Aggregate));
+	if (length <= 0 || length >= (long)sizeof(buf))
+		return -1;
+	memcpy (buf, path, (size_t)length);
+	buf[length]= '\0';
+	strcpy (ag->path, buf);
+
+	if ((q= strchr (buf, ':')) != NULL) {
+		*q++= '\0';
+		if (stricmp (q, "int") == 0)
+			ag->type= agINTEGER;
+		else if (stricmp (q, "str") == 0)
+			ag->type= agSTRING;
+		else
+			return -1;
+	}
+	for (p= buf; ; p= q + 1) {
+		if (ag->depth == agMAXDEPTH)
+			return -1;
+		if ((q= strchr (p, '/')) != NULL)
+			*q= '\0';
+		if (strcmp (p, "*") == 0)
+			ag->cl[ag->depth]= -1;
+		else if (*p != '\0' && (c= strchr (classes, toupper (*p))) != NULL && p[1] == '[' &&
+				 (ag->tag[ag->depth]= strtol (p + 2, &e, 10)) >= 0 && e > p + 2 && strcmp (e, "]") == 0)
+			ag->cl[ag->depth]= (int)(c - classes);
+		else
+			return -1;
+		ag->depth++;
+		if (q == NULL)
+			return 0;
+	}
+}
+
+int agMatch (const Aggregate *ag, int depth, int cl, long tag) {
+	return depth < ag->depth &&
+		   (ag->cl[depth] == -1 || (ag->cl[depth] == cl && ag->tag[depth] == tag));
+}
+
+void agAdd (Aggregate *ag, int cl, long tag, const byte *content, long length) {
+	byte	 buf[8];
+	long	 value;
+	int		 i,
+			 integer;
+
+	if (ag->type == agAUTO)
+		integer= (cl == berUNIVERSAL) ? (tag == berINTEGER || tag == berENUMERATED) : (length >= 1 && length <= 8);
+	else
+		integer= (ag->type == agINTEGER);
+	ag->count++;
+
+	if (integer && berGetInteger (content, length, &value) == 0) {
+		if (ag->integers == 0 || value < ag->min)
+			ag->min= value;
+		if (ag->integers == 0 || value > ag->max)
+			ag->max= value;
+		if ((value > 0 && ag->sum > LONG_MAX - value) || (value < 0 && ag->sum < LONG_MIN - value))
+			ag->overflow= 1;
+		else if (!ag->overflow)
+			ag->sum+= value;
+		ag->integers++;
+		for (i= 0; i < 8; i++)			/* the same value in any encoding */
+			buf[i]= (byte)((unsigned long)value >> (8 * i));
+		AddHash (ag, hashXXH64 (buf, 8, 1));
+		return;
+	}
+
+	if (ag->strings == 0 || Compare (content, length, ag->minstr, ag->minlen) < 0)
+		SetString (ag->minstr, &ag->minlen, content, length);
+	if (ag->strings == 0 || Compare (content, length, ag->maxstr, ag->maxlen) > 0)
+		SetString (ag->maxstr, &ag->maxlen, content, length);
+	ag->strings++;
+	AddHash (ag, hashXXH64 (content, length, 0));
+}
+
+double agDistinct (const Aggregate *ag) {
+	double	 m,
+			 sum,
+			 e;
+	long	 i,
+			 zeros;
+
+	m= (double)(1L << agHLLBITS);
+	sum= 0;
+	zeros= 0;
+	for (i= 0; i < (1L << agHLLBITS); i++) {
+		sum+= ldexp (1.0, -ag->hll[i]);
+		if (ag->hll[i] == 0)
+			zeros++;
+	}
+	e= 0.7213 / (1 + 1.079 / m) * m * m / sum;
+	if (e <= 2.5 * m && zeros > 0)		/* few values: linear counting */
+		e= m * log (m / (double)zeros);
+	return e;
+}
+
+void agPrint (const Aggregate *ag, FILE *fp) {
+	fprintf (fp, "%s: %ld values", ag->path, ag->count);
+	if (ag->integers > 0 && ag->overflow)
+		fprintf (fp, ", %ld integers from %ld to %ld, sum overflowed", ag->integers, ag->min, ag->max);
+	else if (ag->integers > 0)
+		fprintf (fp, ", %ld integers from %ld to %ld, sum %ld, mean %.2f",
+					ag->integers, ag->min, ag->max, ag->sum, (double)ag->sum / (double)ag->integers);
+	if (ag->strings > 0) {
+		fprintf (fp, ", %ld other values from ", ag->strings);
+		PrintString (fp, ag->minstr, ag->minlen);
+		fprintf (fp, " to ");
+		PrintString (fp, ag->maxstr, ag->maxlen);
+	}
+	fprintf (fp, ", about %.0f distinct\n", ag->count > 0 ? agDistinct (ag) : 0.0);
+}
+
+
+/*
+ * HyperLogLog: the first bits of the hash select a register, which keeps
+ * the longest run of leading zeros of the other bits plus one
+ */
+
+static void AddHash (Aggregate *ag, hash64 h) {
+	long	 index;
+	int		 rank;
+
+	index= (long)(h >> (64 - agHLLBITS));
+	h<<= agHLLBITS;
+	for (rank= 1; rank <= 64 - agHLLBITS && !(h & 0x8000000000000000ULL); rank++)
+		h<<= 1;
+	if (rank > ag->hll[index])
+		ag->hll[index]= (byte)rank;
+}
+
+
+/*
+ * strings are compared and kept with their first agMAXSTRING bytes
+ */
+
+static int Compare (const byte *a, long alen, const byte *b, long blen) {
+	long	 la,
+			 lb;
+	int		 rc;
+
+	la= alen < agMAXSTRING ? alen : agMAXSTRING;
+	lb= blen < agMAXSTRING ? blen : agMAXSTRING;
+	if ((rc= memcmp (a, b, (size_t)(la < lb ? la : lb))) != 0)
+		return rc;
+	return (la < lb) ? -1 : (la > lb) ? 1 : 0;
+}
+
+static void SetString (byte *dst, long *dstlen, const byte *src, long length) {
+	memcpy (dst, src, (size_t)(length < agMAXSTRING ? length : agMAXSTRING));
+	*dstlen= length;
+}
+
+static void PrintString (FILE *fp, const byte *s, long length) {
+	long	 i,
+			 n;
+	int		 quoted;
+
+	n= length < agMAXSTRING ? length : agMAXSTRING;
+	quoted= 0;
+	for (i= 0; i < n; i++)
+		if (isprint (s[i]) && s[i] != '"') {
+			fprintf (fp, "%s%c", quoted ? "" : (i > 0 ? " \"" : "\""), s[i]);
+			quoted= 1;
+		} else {
+			fprintf (fp, "%s%02X", quoted ? "\" " : (i > 0 ? " " : ""), s[i]);
+			quoted= 0;
+		}
+	if (quoted)
+		fprintf (fp, "\"");
+	if (n < length)
+		fprintf (fp, " ...");
+	if (length == 0)
+		fprintf (fp, "\"\"");
+}
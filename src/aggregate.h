@@ -0,0 +1,53 @@
+/*
+ *	aggregate.h
+ *
+ *	Includefile for aggregate.c
+ */
+
+#ifndef __AGGREGATE_H__
+#define __AGGREGATE_H__
+
+#include <stdio.h>
+#include "vlARGS.h"
+#include "berhdr.h"
+
+# define	agMAXDEPTH		16		/* components of a path					*/
+# define	agMAXSTRING		64		/* bytes of the smallest/largest string	*/
+# define	agHLLBITS		12		/* 4096 registers, about 1.6% error		*/
+
+/* Types of the values of a path */
+# define	agAUTO			0		/* INTEGER by tag or if 1..8 bytes long	*/
+# define	agINTEGER		1		/* ":int"								*/
+# define	agSTRING		2		/* ":str"								*/
+
+/*
+ *	Streaming aggregates of the values at one path
+ */
+typedef struct {
+	char		 path[128];		/* as given								*/
+	int			 depth;			/* number of components					*/
+	int			 cl[agMAXDEPTH];	/* class, -1 for any tag ("*")		*/
+	long		 tag[agMAXDEPTH];
+	int			 type;
+
+	long		 count;			/* values								*/
+	long		 integers;		/* values which are integers			*/
+	long		 min;
+	long		 max;
+	long		 sum;
+	int			 overflow;		/* the sum doesn't fit into a long		*/
+	long		 strings;		/* other values							*/
+	long		 minlen;		/* length of the smallest string		*/
+	long		 maxlen;
+	byte		 minstr[agMAXSTRING];
+	byte		 maxstr[agMAXSTRING];
+	byte		 hll[1 << agHLLBITS];	/* HyperLogLog registers		*/
+} Aggregate;
+
+EXTERN int		 agParse (Aggregate *, const char *, long);
+EXTERN int		 agMatch (const Aggregate *, int, int, long);
+EXTERN void		 agAdd (Aggregate *, int, long, const byte *, long);
+EXTERN double	 agDistinct (const Aggregate *);
+EXTERN void		 agPrint (const Aggregate *, FILE *);
+
+#endif
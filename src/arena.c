@@ -0,0 +1,164 @@
+/*
+ *	arena.c
+ *
+ *	A bump-pointer allocator. Memory is handed out by incrementing the
+ *	fill pointer of the current block and is released all at once by
+ *	arenaReset(). The blocks are kept for reuse, so after the first few
+ *	resets no more memory is requested from the system.
+ */
+
+# include	<stdlib.h>
+# include	"arena.h"
+
+# define	ALIGN(n)		(((n) + 15) & ~(size_t)15)
+# define	BLOCKDATA(b)	((char *)(b) + ALIGN(sizeof(ArenaBlock)))
+
+
+/*:>* arena.c ***************************************************************
+
+Name
+	arenaInit
+
+Info
+	Initialize an arena
+
+Syntax
+	void arenaInit (Arena *arena, size_t blocksize);
+
+Include
+	arena.h
+
+Description
+	`arenaInit()` initializes `arena`. Memory is requested from the system
+	in blocks of `blocksize` bytes, or larger if a single allocation needs
+	it. No memory is allocated before the first call to `arenaAlloc()`.
+
+See also
+	arenaAlloc
+	arenaFree
+	arenaReset
+
+**************************************************************************<:*/
+
+void arenaInit (Arena *a, size_t blocksize) {
+	a->first= NULL;
+	a->current= NULL;
+	a->blocksize= (blocksize > 0) ? blocksize : 1024 * 1024;
+	a->used= 0;
+	a->highwater= 0;
+	a->reserved= 0;
+	a->resets= 0;
+}
+
+
+/*:>* arena.c ***************************************************************
+
+Name
+	arenaAlloc
+
+Info
+	Allocate memory from an arena
+
+Syntax
+	void *arenaAlloc (Arena *arena, size_t size);
+
+Include
+	arena.h
+
+Description
+	`arenaAlloc()` returns `size` bytes from `arena`, aligned for any type.
+	The memory stays valid until the next call to `arenaReset()` or
+	`arenaFree()`. It must not be passed to `free()`.
+
+Return value
+	The function returns a pointer to the memory or NULL if no more memory
+	is available.
+
+See also
+	arenaReset
+
+**************************************************************************<:*/
+
+void *arenaAlloc (Arena *a, size_t size) {
+	ArenaBlock	*b;
+	size_t		 bsize;
+	void		*p;
+
+	size= ALIGN(size);
+	for (b= a->current; b != NULL; b= b->next) {
+		if (b != a->current)
+			b->used= 0;				/* block wasn't used since last reset */
+		a->current= b;
+		if (b->size - b->used >= size)
+			goto found;
+	}
+
+	bsize= (size > a->blocksize) ? size : a->blocksize;
+	if ((b= malloc (ALIGN(sizeof(ArenaBlock)) + bsize)) == NULL)
+		return NULL;
+	b->size= bsize;
+	b->used= 0;
+	b->next= NULL;
+	if (a->current)
+		a->current->next= b;
+	else
+		a->first= b;
+	a->current= b;
+	a->reserved+= bsize;
+
+found:
+	p= BLOCKDATA(b) + b->used;
+	b->used+= size;
+	a->used+= size;
+	if (a->used > a->highwater)
+		a->highwater= a->used;
+	return p;
+}
+
+
+/*:>* arena.c ***************************************************************
+
+Name
+	arenaReset
+
+Info
+	Release all memory of an arena
+
+Syntax
+	void arenaReset (Arena *arena);
+
+Include
+	arena.h
+
+Description
+	`arenaReset()` releases everything allocated from `arena` at once. The
+	blocks are kept and reused by the following allocations. `arenaFree()`
+	returns the blocks to the system.
+
+See also
+	arenaAlloc
+	arenaFree
+
+**************************************************************************<:*/
+
+void arenaReset (Arena *a) {
+	a->current= a->first;
+	if (a->current)
+		a->current->used= 0;
+	a->used= 0;
+	a->resets++;
+}
+
+void arenaFree (Arena *a) {
+	ArenaBlock	*b,
+				*next;
+
+	for (b= a->first; b != NULL; b= next) {
+		next= b->next;
+		free (b);
+	}
+	a->first= NULL;
+	a->current= NULL;
+	a->used= 0;
+	a->reserved= 0;
+}
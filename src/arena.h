@@ -0,0 +1,34 @@
+/*
+ *	arena.h
+ *
+ *	Includefile for arena.c
+ */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+#include "vlARGS.h"
+
+typedef struct ArenaBlock {
+	struct ArenaBlock	*next;
+	size_t				 size;			/* usable bytes in data				*/
+	size_t				 used;			/* bytes handed out from data		*/
+} ArenaBlock;
+
+typedef struct {
+	ArenaBlock	*first;					/* all blocks, kept over resets		*/
+	ArenaBlock	*current;				/* block allocations are taken from	*/
+	size_t		 blocksize;				/* default size of a new block		*/
+	size_t		 used;					/* bytes allocated since last reset	*/
+	size_t		 highwater;				/* maximum of used					*/
+	size_t		 reserved;				/* bytes requested from the system	*/
+	long		 resets;				/* number of calls to arenaReset()	*/
+} Arena;
+
+EXTERN void		 arenaInit (Arena *, size_t);
+EXTERN void		*arenaAlloc (Arena *, size_t);
+EXTERN void		 arenaReset (Arena *);
+EXTERN void		 arenaFree (Arena *);
+
+#endif
@@ -21,6 +21,7 @@
 # include	<unistd.h>
 # else
 # include	<sys/file.h>
+# include	<unistd.h>
 # endif		/* __TURBOC__ */
 
 # include	<stdlib.h>
@@ -29,163 +30,1690 @@
 # include	<string.h>
 # include	"getargs.h"
 # include	"fileleng.h"
-# include	"akasn1.h"
+# include	"mapfile.h"
+# include	"tlvtree.h"
+# include	"berval.h"
+# include	"oidname.h"
+# include	"schema.h"
+# include	"bercheck.h"
+# include	"stricmp.h"
+# include	"hash64.h"
+# include	"endcache.h"
+# include	"outbuf.h"
+# include	"workpool.h"
+# include	"readahead.h"
+# include	"sink.h"
+# include	"server.h"
+# include	"follow.h"
+# include	"checkpoint.h"
+# include	"aggregate.h"
+
 
 
+/*
+ * One side of a diff: the current element in a list of siblings
+ */
+typedef struct {
+	const char	*name;			/* "A" or "B"							*/
+	const byte	*data;
+	long		 length;		/* length of the file					*/
+	long		 pos;			/* position of the current element		*/
+	long		 end;			/* end of the list, -1 if up to an EOC	*/
+	int			 top;			/* list of top-level elements			*/
+	long		 index;			/* number of the current element		*/
+	BerHeader	 hdr;			/* header of the current element		*/
+	long		 elend;			/* end of the element, -1 if not known	*/
+	EndCache	*cache;			/* ends of indefinite length elements	*/
+} DiffCursor;
 
-static long	 AnalyseTag (void);
-static char	*Class2String (int);
+/*
+ * The path from a top-level element down to an element
+ */
+typedef struct DiffPath {
+	const struct DiffPath	*up;
+	long		 tag;
+	int			 cl;
+	long		 index;
+} DiffPath;
+
+static void	 AggregateNode (Aggregate *, int, long, int, unsigned long);
+static int	 AggregateValues (const char *);
+static void	 AnalyseTag (long, long);
+static void	 CheckReportViolation (long, int, void *);
+static int	 DiffElement (DiffCursor *, DiffCursor *, const DiffPath *);
+static int	 DiffError (DiffCursor *, const char *);
+static int	 DiffFiles (const char *, const char *);
+static int	 DiffList (DiffCursor *, DiffCursor *, const DiffPath *);
+static void	 DiffOnly (DiffCursor *, const DiffPath *);
+static void	 DiffPrintPath (const DiffPath *);
+static int	 DiffRead (DiffCursor *);
+static int	 DiffSkip (DiffCursor *);
+static int	 Extract (const char *);
+static long	 FindChildren (long, long **, long *, long *);
+static int	 HashRecords (void);
+static long	 ParallelRender (WorkPool *);
 static int	 Hexdump (char *);
-static char	*Pc2String (int);
-static void	 PrintIndent (void);
-static long	 ShowValue (byte, byte, byte, long);
-static char	*Tag2String (long, int);
+static void	 HexRow (long, long, long);
+static int	 HexStructure (int);
+static long	 NextElement (long *, BerHeader *);
+static void	 NotShown (long, long, const char *, long);
+static const char *Pc2String (int);
+static void	 PrintIndent (long);
+static void	 PrintLevel (void);
+static void	 PrintOctets (const byte *, long, int);
+static void	 ShowValue (long, int);
+static void	 PrintHeader (long, long, long, long, int, int, int, long, SchemaInfo *);
+static void	 PrintSchemaInfo (SchemaInfo *);
+static int	 QueueTask (WorkPool *, int, long, long);
+static void	 RenderTask (WorkPool *, WpTask *);
+static int	 Sampled (long);
+static int	 SaveCheckpoint (Checkpoint *);
+static int	 ServeRender (const byte *, long, long, long, const char *, OutBuf *);
+static int	 ServeRequest (const char *, const char *);
+static int	 SetSwitches (const char *);
+static void	 SetWidth (long);
+static void	 SkipValue (long);
+static const char *Tag2String (long, int);
+static int	 Validate (int);
 
-int		 do_context   = 0;		/* Try to analyse context-tags			*/
+/*
+ * Switches of the renderer as given on the command line, each thread
+ * renders with a copy made by SetSwitches()
+ */
+typedef struct {
+	int		 context;		/* Try to analyse context-tags			*/
+	int		 octhex;		/* hexdump octet strings				*/
+	int		 prtoffset;		/* Print the current offset in the file */
+	int		 oidnames;		/* Show the names of OIDs				*/
+} Switches;
+
+Switches given        = { 0, 0, 0, 0 };
 int		 do_hexdump   = 0;		/* hexdump file only					*/
-int		 do_octhex    = 0;		/* hexdump octet strings				*/
-int		 offset       = 0;		/* offset in File						*/
-int		 do_prtoffset = 0;		/* Print the current offset in the file */
-int		 indent       = 0;		/* Number of indent-tabs				*/
+int		 do_hexasn1   = 0;		/* hexdump with the ASN.1 structure		*/
+long	 offset       = 0;		/* offset in File						*/
+char	*offsets      = NULL;	/* Print start, content and end: "dec" or "hex" */
+int		 offsetbase   = 0;		/* 10 or 16 with -offsets				*/
+int		 do_stats     = 0;		/* Print statistics at the end			*/
+char	*oidfile      = NULL;	/* File with additional OID names		*/
+char	*schemafile   = NULL;	/* ASN.1 module to name the elements	*/
+char	*roottype     = NULL;	/* Type of the top-level elements		*/
+char	*difffile     = NULL;	/* File to compare with					*/
+char	*validate     = NULL;	/* Check the encoding: "der" or "ber"	*/
+int		 do_hash      = 0;		/* Print a hash of each element			*/
+int		 do_dups      = 0;		/* Report duplicate elements			*/
+char	*extract      = NULL;	/* Elements to copy to stdout			*/
+long	 differences  = 0;		/* Number of differences found			*/
+long	 rootcontext  = -1;		/* Schema context of top-level elements	*/
+int		 threads      = 1;		/* Number of threads to render with		*/
+int		 readdepth    = 0;		/* Reads in flight ahead of the decoder	*/
+long	 blocksize    = 1024;	/* KB per read ahead					*/
+char	*outfile      = NULL;	/* File to write the output to			*/
+char	*compress     = NULL;	/* Compression of the output			*/
+char	*servesocket  = NULL;	/* Serve requests on this socket		*/
+char	*connectsocket= NULL;	/* Send the file to the server there	*/
+int		 do_bypath    = 0;		/* Send the path instead of the data	*/
+int		 do_follow    = 0;		/* Wait for the file to grow			*/
+char	*checkfile    = NULL;	/* Checkpoint to resume from and update	*/
+long	 resume       = 0;		/* End of the last complete element		*/
+long	 maxdepth     = 0;		/* Levels shown, 0 for all				*/
+long	 maxnodes     = 0;		/* Nodes shown per element, 0 for all	*/
+long	 maxvalue     = 0;		/* Bytes shown per value, 0 for all		*/
+double	 samplerate   = 0;		/* Share of the elements shown			*/
+long	 sampleevery  = 0;		/* Show every n-th element				*/
+int		 sampling     = 0;		/* One of them is given					*/
+long	 scanned      = 0;		/* Top-level elements seen by Sampled()	*/
+char	*aggregatepaths= NULL;	/* Paths of the values to aggregate		*/
 long	 flength      = 0;
 
-int
-main(int argc, char *argv[]) {
+MappedFile	 mf;					/* The mapped ASN.1-file				*/
+OutBuf		 stdoutbuf;				/* Output of the main thread			*/
+Readahead	 readahead;				/* Reads ahead of the decoder			*/
+Sink		*sink;					/* Writer of the rendered output		*/
+
+/*
+ * State of the renderer, each thread renders with its own
+ */
+THREAD_LOCAL TlvTree	 tree;		/* TLV tree of the current element		*/
+THREAD_LOCAL EndCache	 endcache;	/* Ends of indefinite length elements	*/
+THREAD_LOCAL int		 indent;	/* Number of indent-tabs				*/
+THREAD_LOCAL OutBuf		*out;		/* Buffer for the output				*/
+THREAD_LOCAL int		 do_context;	/* The switches in given, or changed by	*/
+THREAD_LOCAL int		 do_octhex;		/* the flags of a request to the server	*/
+THREAD_LOCAL int		 do_prtoffset;
+THREAD_LOCAL int		 do_oidnames;
+THREAD_LOCAL int		 offsetwidth;	/* Digits of the offsets shown			*/
+
+# define	FLUSHSIZE	65536		/* output is written in pieces of this size	*/
+
+/*
+ * Names of tags, classes and hex pairs. The tables are built by the
+ * preprocessor, so a header line is put together from strings without
+ * formatting anything but the numbers.
+ */
+static const char *const tagstrings[]= {
+		  /*    0 (printed as printf did for the missing name)            */
+			"(null)",
+		  /*    1                      2                  3           */
+			"Boolean",	 			"Integer",			"Bitstring",
+		  /*    4          	           5                  6           */
+			"Octetstring",			"Null",				"Objectidentifier",
+		  /*    7                      8                  9           */
+			"Objectdescriptor",		"External",			"Real",
+		  /*   10                     11                 12           */
+			"Enumerated",			"Embedded PDV",		"UTF8 String",
+		  /*   13                     14                 15           */
+			"Relative OID",			"<reserved>",		"<reserved>",
+		  /*   16                     17                 18           */
+			"Sequence",				"Set",				"NumString",
+		  /*   19              		  20                 21           */
+			"Printable String",		"Teletex",			"Videotex",
+		  /*   22            	  	  23                 24           */
+			"IA5 String",			"UCTtime",			"Time",
+		  /*   25           		  26                 27           */
+			"Graphic String",		"Visible String",	"General String",
+		  /*   28           		  29                 30           */
+			"Universal String",		"Character String",	"BMP String"
+			};
+
+# define	MAXTAGSTRING	30
+
+/* "A[0]" to "A[63]" etc. for the tag numbers which are used most */
+# define	TAGS10(c,d)	c "[" d "0]", c "[" d "1]", c "[" d "2]", c "[" d "3]", c "[" d "4]", \
+					c "[" d "5]", c "[" d "6]", c "[" d "7]", c "[" d "8]", c "[" d "9]"
+# define	TAGS64(c)	TAGS10(c,""), TAGS10(c,"1"), TAGS10(c,"2"), TAGS10(c,"3"), \
+					TAGS10(c,"4"), TAGS10(c,"5"), c "[60]", c "[61]", c "[62]", c "[63]"
+# define	MAXTAGNAME	63
+
+static const char *const tagnames[3][MAXTAGNAME + 1]= {
+			{ TAGS64("A") },		/* berAPPLICATION */
+			{ TAGS64("C") },		/* berCONTEXT */
+			{ TAGS64("P") }			/* berPRIVATE */
+			};
+
+/* class and form of a header line, indexed by class << 1 | pc */
+static const char *const clpcnames[8]= {
+			"(UNIV/PRIM)", "(UNIV/CONST)", "(APPL/PRIM)", "(APPL/CONST)",
+			"(CONT/PRIM)", "(CONT/CONST)", "(PRIV/PRIM)", "(PRIV/CONST)"
+			};
+
+/* "00 " to "FF " */
+# define	HEX16(h)	h "0 ", h "1 ", h "2 ", h "3 ", h "4 ", h "5 ", h "6 ", h "7 ", \
+					h "8 ", h "9 ", h "A ", h "B ", h "C ", h "D ", h "E ", h "F "
+
+static const char hexpairs[256][4]= {
+			HEX16("0"), HEX16("1"), HEX16("2"), HEX16("3"),
+			HEX16("4"), HEX16("5"), HEX16("6"), HEX16("7"),
+			HEX16("8"), HEX16("9"), HEX16("A"), HEX16("B"),
+			HEX16("C"), HEX16("D"), HEX16("E"), HEX16("F")
+			};
 
-	do_context   = is_arg ("-context", argc, argv);
-	do_hexdump   = is_arg ("-dump", argc, argv);
-	do_octhex    = is_arg ("-octhex", argc, argv);
-	do_prtoffset = is_arg ("-prtoffset", argc, argv);
-	offset       = intval ("-offset", argc, argv);
+/* for the indent */
+static const char	spaces[] = "                                                                ";
 
-	if (getremain (argc) != 1) {
+
+/*
+ * Command line options, parsed in one pass by getoptions()
+ */
+static ArgsOption options[] = {
+	{ "-context",   "--context",   argsFLAG,   &given.context },
+	{ "-dump",      "--dump",      argsFLAG,   &do_hexdump },
+	{ "-hexasn1",   "--hexasn1",   argsFLAG,   &do_hexasn1 },
+	{ "-octhex",    "--octhex",    argsFLAG,   &given.octhex },
+	{ "-prtoffset", "--prtoffset", argsFLAG,   &given.prtoffset },
+	{ "-offsets",   "--offsets",   argsSTRING, &offsets },
+	{ "-offset",    "--offset",    argsLONG,   &offset },
+	{ "-stats",     "--stats",     argsFLAG,   &do_stats },
+	{ "-oids",      "--oids",      argsFLAG,   &given.oidnames },
+	{ "-oidfile",   "--oidfile",   argsSTRING, &oidfile },
+	{ "-schema",    "--schema",    argsSTRING, &schemafile },
+	{ "-root",      "--root",      argsSTRING, &roottype },
+	{ "-diff",      "--diff",      argsSTRING, &difffile },
+	{ "-validate",  "--validate",  argsSTRING, &validate },
+	{ "-hash",      "--hash",      argsFLAG,   &do_hash },
+	{ "-dups",      "--dups",      argsFLAG,   &do_dups },
+	{ "-extract",   "--extract",   argsSTRING, &extract },
+	{ "-threads",   "--threads",   argsINT,    &threads },
+	{ "-readahead", "--readahead", argsINT,    &readdepth },
+	{ "-blocksize", "--blocksize", argsLONG,   &blocksize },
+	{ "-o",         "--output",    argsSTRING, &outfile },
+	{ "-z",         "--compress",  argsSTRING, &compress },
+	{ "-serve",     "--serve",     argsSTRING, &servesocket },
+	{ "-connect",   "--connect",   argsSTRING, &connectsocket },
+	{ "-bypath",    "--bypath",    argsFLAG,   &do_bypath },
+	{ "-follow",    "--follow",    argsFLAG,   &do_follow },
+	{ "-checkpoint","--checkpoint",argsSTRING, &checkfile },
+	{ "-maxdepth",  "--maxdepth",  argsLONG,   &maxdepth },
+	{ "-maxnodes",  "--maxnodes",  argsLONG,   &maxnodes },
+	{ "-maxbytes-per-value", "--maxbytes-per-value", argsLONG, &maxvalue },
+	{ "-sample",    "--sample",    argsDOUBLE, &samplerate },
+	{ "-sample-every", "--sample-every", argsLONG, &sampleevery },
+	{ "-aggregate", "--aggregate", argsSTRING, &aggregatepaths },
+	{ NULL,         NULL,          0,          NULL }
+};
+
+int
+main(int argc, char *argv[]) {
+	WorkPool	*pool;
+	Follow		 follow;
+	Checkpoint	 checkpoint;
+	long		 pos,
+				 next,
+				 records,
+				 tasks,
+				 steals,
+				 produced,
+				 written;
+	double		 busy;
+	char		**files;
+	int			 i,
+				 method,
+				 rc;
+
+	i = getoptions (options, argc, argv, &files);
+	if (i != (servesocket != NULL ? 0 : 1)) {
+		if (i == -1)
+			fprintf (stderr, "asn1dump: %s\n", argsError ());
 		fprintf (stderr, "\nasn1dump -- ");
 		fprintf (stderr, "written by Andreas Kraft\n");
 		fprintf (stderr,"\n");
-		fprintf (stderr, "usage: asn1dump [Options] <filename>\n\n");
+		fprintf (stderr, "usage: asn1dump [Options] <filename>\n");
+		fprintf (stderr, "       asn1dump -diff <fileA> <fileB>\n");
+		fprintf (stderr, "       asn1dump -serve <socket> [Options]\n");
+		fprintf (stderr, "       asn1dump -connect <socket> [-bypath] [-offset <pos>] [-context] [-octhex]\n");
+		fprintf (stderr, "                [-prtoffset] [-oids] <filename>\n\n");
 		fprintf (stderr, "       Options:\n\n");
 		fprintf (stderr, "       -context      : try to show content of context tags\n");
 		fprintf (stderr, "       -octhex       : hexdump octet strings\n");
 		fprintf (stderr, "       -dump         : hexdump only\n");
+		fprintf (stderr, "       -hexasn1      : hexdump with the headers and nesting of the elements\n");
 		fprintf (stderr, "       -prtoffset    : Print the current offset\n");
+		fprintf (stderr, "       -offsets <b>  : print start, content and end of the elements in 'b' (dec or hex)\n");
 		fprintf (stderr, "       -offset <pos> : start at byte offset 'pos'\n");
+		fprintf (stderr, "       -stats        : print memory statistics to stderr\n");
+		fprintf (stderr, "       -oids         : show the names of object identifiers\n");
+		fprintf (stderr, "       -oidfile <f>  : read additional OID names from file 'f'\n");
+		fprintf (stderr, "       -schema <f>   : name elements after the ASN.1 module in file 'f'\n");
+		fprintf (stderr, "       -root <type>  : type of the top-level elements in the schema\n");
+		fprintf (stderr, "       -diff <fileA> : show where the elements of 'fileA' and <filename> differ\n");
+		fprintf (stderr, "       -validate <r> : check the encoding rules 'r' (der or ber), don't show\n");
+		fprintf (stderr, "       -hash         : print offset, hash and length of each element\n");
+		fprintf (stderr, "       -dups         : report elements which are duplicates of earlier ones\n");
+		fprintf (stderr, "       -extract <s>  : copy elements N, N-M, N- or with tag 's' (e.g. A[1]) to stdout\n");
+		fprintf (stderr, "       -threads <n>  : render the elements with 'n' threads\n");
+		fprintf (stderr, "       -readahead <n>: keep 'n' reads in flight ahead of the decoder\n");
+		fprintf (stderr, "       -blocksize <k>: read ahead in blocks of 'k' KB (default 1024)\n");
+		fprintf (stderr, "       -o <file>     : write the output to 'file'\n");
+		fprintf (stderr, "       -z <method>   : compress the output with gzip or zstd\n");
+		fprintf (stderr, "       -serve <s>    : render requests on the Unix socket 's'\n");
+		fprintf (stderr, "       -connect <s>  : let the server at socket 's' render <filename>\n");
+		fprintf (stderr, "       -bypath       : send the path of <filename> instead of its content\n");
+		fprintf (stderr, "       -follow       : show new elements as <filename> grows\n");
+		fprintf (stderr, "       -checkpoint <f>: resume after the elements shown by the last run\n");
+		fprintf (stderr, "       -maxdepth <n> : show 'n' levels, summarize the content below\n");
+		fprintf (stderr, "       -maxnodes <n> : show 'n' nodes per element, summarize the rest\n");
+		fprintf (stderr, "       -maxbytes-per-value <n>: show the first 'n' bytes of longer values\n");
+		fprintf (stderr, "       -sample <r>   : show a share 'r' (e.g. 0.01) of the elements\n");
+		fprintf (stderr, "       -sample-every <n>: show every 'n'-th element\n");
+		fprintf (stderr, "       -aggregate <p>: count, min, max, sum and distinct values at the paths 'p'\n");
+		fprintf (stderr, "\n");
+		fprintf (stderr, "       Options may be written as --name or --name=value, '@f' reads\n");
+		fprintf (stderr, "       arguments from file 'f' and '--' ends the options.\n");
 		fprintf (stderr, "\n");
 		return 1;
 	}
 
+	if (offsets != NULL) {
+		if (stricmp (offsets, "dec") == 0)
+			offsetbase = 10;
+		else if (stricmp (offsets, "hex") == 0)
+			offsetbase = 16;
+		else {
+			fprintf (stderr, "asn1dump: -offsets needs 'dec' or 'hex'\n");
+			return 1;
+		}
+	} /* if */
+	if ((method = skMethod (compress)) == -1) {
+		fprintf (stderr, "asn1dump: compression '%s' isn't available\n", compress);
+		return 1;
+	} /* if */
+	if (method != skPLAIN && (do_hexdump || difffile || validate || do_hash || do_dups || extract || aggregatepaths)) {
+		fprintf (stderr, "asn1dump: -z only applies to the dump of the elements\n");
+		return 1;
+	} /* if */
+	if (do_follow && (do_hexdump || do_hexasn1 || difffile || validate || do_hash || do_dups || extract || aggregatepaths || connectsocket)) {
+		fprintf (stderr, "asn1dump: -follow only applies to the dump of the elements\n");
+		return 1;
+	} /* if */
+	if (samplerate < 0 || samplerate > 1 || sampleevery < 0 || (samplerate > 0 && sampleevery > 0)) {
+		fprintf (stderr, "asn1dump: -sample needs a share from 0 to 1, or -sample-every a count\n");
+		return 1;
+	} /* if */
+	sampling = (samplerate > 0 && samplerate < 1) || sampleevery > 1;
+	if (sampling && (do_hexdump || do_hexasn1 || difffile || do_hash || do_dups || extract || connectsocket || servesocket)) {
+		fprintf (stderr, "asn1dump: -sample only applies to the dump, -validate and -aggregate\n");
+		return 1;
+	} /* if */
+	if (checkfile != NULL && (do_hexdump || do_hexasn1 || difffile || validate || do_hash || do_dups || extract || aggregatepaths || connectsocket || servesocket)) {
+		fprintf (stderr, "asn1dump: -checkpoint only applies to the dump of the elements\n");
+		return 1;
+	} /* if */
+	if (outfile != NULL && freopen (outfile, "wb", stdout) == NULL) {
+		fprintf (stderr, "asn1dump: can't create file '%s'\n", outfile);
+		return 1;
+	} /* if */
+
+	if (connectsocket != NULL)	/* client of a server */
+		return ServeRequest (connectsocket, files[0]);
+
 	if (do_hexdump) {		/* do hexdump only ! */
-		Hexdump (argv[getindex()+1]);
+		Hexdump (files[0]);
 		return 0;
 	} /* if */
 
+	if (difffile != NULL)	/* compare two files */
+		return DiffFiles (difffile, files[0]);
+
+	if (validate != NULL && stricmp (validate, "der") != 0 && stricmp (validate, "ber") != 0) {
+		fprintf (stderr, "asn1dump: -validate needs 'der' or 'ber'\n");
+		return 2;
+	} /* if */
+
 
-	/* Open ASN.1-file */
-	if (asnOpenReadFile (argv[getindex()+1]) == -1) {
-		fprintf (stderr, "asn1dump: can't open file '%s'\n",argv[getindex()+1]);
+	if (oidfile != NULL) {
+		if (oidLoadFile (oidfile) == -1) {
+			fprintf (stderr, "asn1dump: can't load OID names from '%s'\n", oidfile);
+			return 1;
+		}
+		given.oidnames = 1;
+	} /* if */
+	if ((given.oidnames || servesocket != NULL) && oidBuild () == -1) {	/* a request may ask for them */
+		fprintf (stderr, "asn1dump: not enough memory for OID names\n");
+		return 1;
+	} /* if */
+
+	if (schemafile != NULL) {
+		if (schemaLoad (schemafile) == -1) {
+			fprintf (stderr, "asn1dump: can't load schema from '%s'\n", schemafile);
+			return 1;
+		}
+		if ((rootcontext = schemaRoot (roottype)) == -1) {
+			fprintf (stderr, "asn1dump: type '%s' not defined in '%s'\n", roottype, schemafile);
+			return 1;
+		}
+	} /* if */
+
+	SetSwitches (NULL);
+	if (servesocket != NULL)	/* render for clients */
+		return srvServe (servesocket, threads, ServeRender) == 0 ? 0 : 1;
+
+	/* Map ASN.1-file */
+	if (mapOpen (&mf, files[0]) == -1) {
+		fprintf (stderr, "asn1dump: can't open file '%s'\n", files[0]);
 		return 1;
 	}
-	
-	flength = filelength(asnfd);
-	asnFseek ((long)offset);
+	flength = mf.length;
+	SetWidth (flength);
+	tlvInit (&tree, mf.data, flength);
+	if (ecInit (&endcache, 0) == -1) {
+		fprintf (stderr, "asn1dump: not enough memory\n");
+		return 1;
+	}
+	if (readdepth > 0 && mf.mapped && !do_follow)	/* a file which is read is in memory already */
+		raStart (&readahead, mf.fd, flength, readdepth, blocksize * 1024);
+
+	if (validate != NULL) {
+		pos = Validate (stricmp (validate, "der") == 0);
+		raStop (&readahead);
+		tlvFree (&tree);
+		ecFree (&endcache);
+		mapClose (&mf);
+		return (int)pos;
+	} /* if */
 
-	while (AnalyseTag () != -1)   /* empty */ ;
+	if (extract != NULL) {
+		pos = Extract (extract);
+		raStop (&readahead);
+		tlvFree (&tree);
+		ecFree (&endcache);
+		mapClose (&mf);
+		return (int)pos;
+	} /* if */
 
-	/* Close ASN.1-file */
-	asnCloseFile ();
+	if (aggregatepaths != NULL) {
+		pos = AggregateValues (aggregatepaths);
+		raStop (&readahead);
+		tlvFree (&tree);
+		ecFree (&endcache);
+		mapClose (&mf);
+		return (int)pos;
+	} /* if */
 
-	return 0;
+	if (do_hexasn1) {
+		pos = HexStructure (method);
+		raStop (&readahead);
+		tlvFree (&tree);
+		ecFree (&endcache);
+		mapClose (&mf);
+		return (int)pos;
+	} /* if */
+
+	if (do_hash || do_dups) {
+		pos = HashRecords ();
+		raStop (&readahead);
+		tlvFree (&tree);
+		ecFree (&endcache);
+		mapClose (&mf);
+		return (int)pos;
+	} /* if */
+
+	/*
+	 * Build the tree of each top-level element in one pass over its
+	 * headers, then render it.
+	 */
+	if ((sink = skOpen (stdout, method)) == NULL) {
+		fprintf (stderr, "asn1dump: not enough memory\n");
+		return 1;
+	}
+	out = &stdoutbuf;
+	tree.maxdepth = maxdepth;
+	tree.maxnodes = maxnodes;
+	records = 0;
+	rc = 0;
+	if (checkfile != NULL) {	/* go on where the last run ended */
+		switch (cpLoad (&checkpoint, checkfile)) {
+			case cpOK:
+				if (cpCheck (&checkpoint, mf.data, flength) == 0)
+					offset = checkpoint.offset;
+				else
+					fprintf (stderr, "asn1dump: '%s' doesn't match checkpoint '%s', starting at %ld\n",
+								files[0], checkfile, offset);
+				break;
+			case cpBROKEN:
+				fprintf (stderr, "asn1dump: '%s' isn't a checkpoint, starting at %ld\n", checkfile, offset);
+				break;
+		} /* switch */
+	} /* if */
+	pos = resume = offset;
+	if (do_follow && flOpen (&follow, files[0]) == -1) {
+		fprintf (stderr, "asn1dump: can't open file '%s'\n", files[0]);
+		return 1;
+	}
+	if (threads > 1 && !do_follow && (pool = wpCreate (threads, RenderTask)) != NULL) {
+		records = ParallelRender (pool);
+		if (do_stats)
+			for (i = 0; wpThreadStats (pool, i, &tasks, &steals, &busy) == 0; i++)
+				fprintf (stderr, "asn1dump: thread %d: %ld tasks, %ld stolen, %.0f%% busy\n", 
+							i, tasks, steals, 100.0 * busy);
+		wpDestroy (pool);
+		if (records == -1)
+			rc = 1;
+		pos = flength;		/* done */
+	} /* if */
+
+	for (;;) {
+		while (pos < flength && pos >= 0) {
+			if (do_follow && ecFindEnd (&endcache, mf.data, flength, pos) == berTRUNCATED)
+				break;		/* not completely written yet */
+			raAdvance (&readahead, pos);
+			if (sampling && !Sampled (pos) && (next = ecFindEnd (&endcache, mf.data, flength, pos)) > pos) {
+				resume = pos = next;	/* skipped by its length */
+				continue;
+			}
+			tlvReset (&tree);
+			pos = tlvParse (&tree, pos, flength, -1, 0);
+			if (tree.count > 0) {
+				AnalyseTag (0, rootcontext);
+				records++;
+			}
+			if (pos == tlvNOMEM || out->failed) {
+				fprintf (stderr, "asn1dump: not enough memory\n");
+				pos = tlvNOMEM;		/* stop */
+				rc = 1;
+				break;
+			} /* if */
+			if (pos >= 0)
+				resume = pos;
+			if (pos == tlvERROR) {
+				obPrintf (out, "at position %ld: unexpected length (%ld) encountered\n", tree.errpos, tree.errlen);
+				rc = 1;
+			} else if (pos == tlvEOF) {
+				obPrintf (out, "at position %ld: incomplete element at end of data\n", tree.errpos);
+				rc = 1;
+			} /* if */
+			if (out->length >= FLUSHSIZE)
+				skFlush (sink, out);
+		} /* while */
+		if (!do_follow || pos < 0)
+			break;
+
+		/* show what there is, then go on behind the last complete element */
+		skFlush (sink, out);
+		skSync (sink);
+		if (checkfile != NULL && SaveCheckpoint (&checkpoint) == -1)
+			rc = 1;
+		if (flWait (&follow, flength) == -1) {
+			fprintf (stderr, "asn1dump: '%s' was truncated\n", files[0]);
+			rc = 1;
+			break;
+		}
+		if (mapRefresh (&mf) == -1) {
+			fprintf (stderr, "asn1dump: can't map file '%s'\n", files[0]);
+			rc = 1;
+			break;
+		}
+		flength = mf.length;
+		SetWidth (flength);
+		tree.data = mf.data;
+		tree.dlength = flength;
+	} /* for */
+	skFlush (sink, out);
+	if (skClose (sink, &produced, &written) == EOF) {
+		fprintf (stderr, "asn1dump: can't write the output\n");
+		rc = 1;
+	} else if (checkfile != NULL && SaveCheckpoint (&checkpoint) == -1)
+		rc = 1;
+
+	if (do_stats) {
+		tlvReset (&tree);
+		fprintf (stderr, "asn1dump: %ld elements, max. %ld nodes per element\n", records, tree.maxcount);
+		if (sampling)
+			fprintf (stderr, "asn1dump: %ld of %ld elements sampled\n", records, scanned);
+		fprintf (stderr, "asn1dump: arena high-water mark %lu bytes, %lu bytes reserved\n",
+					(unsigned long)tree.arena.highwater, (unsigned long)tree.arena.reserved);
+		if (checkfile != NULL)
+			fprintf (stderr, "asn1dump: elements from %ld to %ld, checkpoint saved\n", offset, resume);
+		if (readdepth > 0)
+			fprintf (stderr, "asn1dump: read-ahead with %s: %ld reads, %ld KB\n",
+						raMethod (&readahead), readahead.reads, readahead.bytes / 1024);
+		if (method != skPLAIN)
+			fprintf (stderr, "asn1dump: %ld KB of output, %ld KB written with %s\n",
+						produced / 1024, written / 1024, compress);
+	} /* if */
+
+	if (do_follow)
+		flClose (&follow);
+	raStop (&readahead);
+	tlvFree (&tree);
+	ecFree (&endcache);
+	mapClose (&mf);
+
+	return rc;
 }
 
 
 /****************************************************************************/
 
-static long AnalyseTag (void) {
-	byte	 tbuf[10];
-	byte	 cl,
-			 pc,
-			 tag;
-	long	 l,
-			 length,
-			 glen,
-			 lpos,
-			 showlen;
-	int		 taglen,
-			 lengthlen;
-	int		 i;
-	byte	 buffer;
-
-	if ((taglen= asnReadTag (tbuf)) == -1) 
+/*
+ * Tell whether the top-level element at pos is shown with -sample or
+ * -sample-every, the others are skipped by their length. For -sample the
+ * choice is made from a hash of the offset, so every run of a file takes
+ * the same elements. Padding isn't counted and never sampled.
+ */
+
+static int Sampled (long pos) {
+	hash64	 h;
+
+	if (pos + 1 < flength && mf.data[pos] == 0 && mf.data[pos + 1] == 0)
+		return 0;
+	if (sampleevery > 1)
+		return scanned++ % sampleevery == 0;
+	scanned++;
+	h = (hash64)pos + 0x9E3779B97F4A7C15ULL;		/* splitmix64 */
+	h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+	h ^= h >> 31;
+	return (double)(h >> 11) < samplerate * 9007199254740992.0;	/* 2^53 */
+}
+
+
+/*
+ * Save the end of the last complete element as checkpoint for the next
+ * run. Returns 0 or -1 if the file can't be written.
+ */
+
+static int SaveCheckpoint (Checkpoint *cp) {
+	cpMark (cp, mf.data, resume);
+	if (cpSave (cp, checkfile) == -1) {
+		fprintf (stderr, "asn1dump: can't write checkpoint '%s'\n", checkfile);
 		return -1;
+	}
+	return 0;
+}
 
-	asnDecodeTag (&cl, &pc, &tag, tbuf);
-	lpos = asnFtell();
-	lengthlen= asnReadLength (&length);
-/* fprintf (stderr, "length=%ld----Restlength=%ld\n", length, flength-asnFtell()); */
 
-	if (length<-1 || length>(flength-asnFtell())) {
-		printf ("at position %ld: unexpected length (%ld) encountered\n", lpos, length);
-		exit (1);
-	} /* if */
+/*
+ * Render with a pool of threads. The top-level elements are parsed here
+ * to find their ends, and handed to the pool in tasks of about BATCHSIZE
+ * bytes. Elements of more than SPLITSIZE bytes are only scanned by their
+ * headers and get a task of their own, which splits them further (see
+ * RenderTask()). The output of the tasks is written in order, so it is
+ * the same as without threads. With -maxdepth or -maxnodes elements are
+ * not split, the limits apply to whole top-level elements.
+ * Returns the number of top-level elements or -1 after an error.
+ */
+
+# define	BATCHSIZE	(1L << 16)	/* bytes of elements per task				*/
+# define	SPLITSIZE	(1L << 20)	/* smaller elements aren't split			*/
+# define	TASKSAHEAD	16			/* tasks per thread ahead of the output		*/
+
+# define	taskRENDER		0		/* render the elements in arg[0] .. arg[1]	*/
+# define	taskSPLIT		1		/* split the element at arg[0]				*/
+
+static long ParallelRender (WorkPool *pool) {
+	long	 pos,
+			 start,
+			 next,
+			 split,
+			 records;
+	int		 status;
+
+	status = wpCONTINUE;
+	records = 0;
+	split = (maxdepth > 0 || maxnodes > 0) ? flength + 1 : SPLITSIZE;	/* limits are per element */
+	for (pos = offset; pos < flength && pos >= 0 && status == wpCONTINUE; ) {
+		for (start = pos; pos < flength && pos - start < BATCHSIZE; pos = resume = next) {
+			raAdvance (&readahead, pos);
+			if (sampling && !Sampled (pos) && (next = ecFindEnd (&endcache, mf.data, flength, pos)) > pos) {
+				/* skipped by its length, the elements before are a task */
+				if (pos > start && QueueTask (pool, taskRENDER, start, pos) == -1)
+					return -1;
+				start = next;
+				continue;
+			} /* if */
+			if (pos + 1 < flength && mf.data[pos] == 0 && mf.data[pos + 1] == 0) {
+				next = pos + 2;		/* padding */
+				continue;
+			}
+			/* the elements are only scanned, the tasks parse them and report errors */
+			if ((next = ecFindEnd (&endcache, mf.data, flength, pos)) < 0) {
+				pos = flength;
+				break;
+			}
+			records++;
+			if (next - pos >= split) {
+				if ((pos > start && QueueTask (pool, taskRENDER, start, pos) == -1) ||
+					QueueTask (pool, taskSPLIT, pos, next) == -1)
+					return -1;
+				start = next;
+			} /* if */
+		} /* for */
+		if (pos > start && QueueTask (pool, taskRENDER, start, pos) == -1)
+			return -1;
+		status = wpWrite (pool, sink, TASKSAHEAD * threads);
+	} /* for */
+	if (status == wpCONTINUE)
+		status = wpWrite (pool, sink, 0);
+	if (status == wpNOMEM)
+		fprintf (stderr, "asn1dump: not enough memory\n");
+	if (status == wpERROR || status == wpNOMEM) {
+		resume = offset;	/* the failed element isn't known here */
+		return -1;
+	}
+	return records;
+}
 
-	if (tag == asnNOTHING && cl == asnUNIVERSAL && length==0)
-		return asnENDCONTENTS;
-		
 
-	PrintIndent ();
-	printf ("%s (taglength= %d length= %ld) (%s/%s)", 
-				Tag2String (tag, cl), 
-				taglen,
-				length,
-				Class2String (cl),
-				Pc2String (pc)
-			);
+/*
+ * Add a task of ParallelRender() for the elements from start to end.
+ * Returns 0 or -1 if there isn't enough memory.
+ */
 
-	glen= (long)taglen + (long)lengthlen + length;
+static int QueueTask (WorkPool *pool, int kind, long start, long end) {
+	WpTask	*task;
 
-	if ((showlen= ShowValue (tag, cl, pc, length)) == -1)
+	if ((task = wpSpawn (pool, NULL, kind, start, end, rootcontext, 0)) == NULL || wpPush (pool, task) == -1) {
+		fprintf (stderr, "asn1dump: not enough memory\n");
 		return -1;
+	}
+	return 0;
+}
 
-	length-= showlen;
 
-	if ( cl!=asnCONTEXT || 
-	    (cl==asnCONTEXT && pc==asnCONSTRUCTED) ||
-		(cl==asnAPPLICATION && pc==asnCONSTRUCTED) ||
-		(cl==asnCONTEXT && pc==asnPRIMITIVE && do_context)) {
+/*
+ * Run a task of ParallelRender(). A task to split an element finds its
+ * children by their headers only. If the element has just one constructed
+ * child, its children are taken instead, and so on. The header lines down
+ * to that element are printed by the task, the children are cut into
+ * subtasks which are rendered at their indent. If the children can't be
+ * told apart without parsing, the element is rendered as a whole.
+ * Called without a task when a worker ends, to free its tree and cache.
+ */
 
-		if (pc==asnCONSTRUCTED || tag==asnEXTERNAL)	{
-			indent++;
-			while (length>0 || length==-1) {
-				if ((l= AnalyseTag ()) == -1)	/* Recursion !! */
-					return -1;
-				if (l == asnENDCONTENTS) {
-					indent--;
-					return asnENDCONTENTS;
+static void RenderTask (WorkPool *pool, WpTask *task) {
+	BerHeader	 hdr;
+	SchemaInfo	 info;
+	WpTask		*sub,
+				**subs;
+	long		 pos,
+				 context,
+				*child,
+				 count,
+				 size,
+				 path[64],
+				 i,
+				 n,
+				 first;
+	int			 depth,
+				 d;
+
+	if (task == NULL) {		/* the worker ends */
+		tlvFree (&tree);
+		ecFree (&endcache);
+		return;
+	}
+	if (tree.data == NULL) {
+		tlvInit (&tree, mf.data, flength);
+		tree.maxdepth = maxdepth;
+		tree.maxnodes = maxnodes;
+		SetSwitches (NULL);
+		SetWidth (flength);
+	}
+	out = &task->out;
+	indent = (int)task->arg[3];
+
+	if (task->kind == taskSPLIT) {
+		/* find the element to split */
+		if (endcache.size == 0 && ecInit (&endcache, 0) == -1)
+			task->kind = taskRENDER;
+		child = NULL;
+		count = size = 0;
+		pos = task->arg[0];
+		for (depth = 0; task->kind == taskSPLIT; depth++) {
+			path[depth] = pos;
+			if (FindChildren (pos, &child, &count, &size) == -1)
+				task->kind = taskRENDER;
+			else if (count != 1 || depth + 1 == sizeof(path) / sizeof(long) ||
+				berReadHeader (mf.data + child[0], flength - child[0], &hdr) < 0 ||
+				hdr.pc != berCONSTRUCTED)
+				break;
+			else
+				pos = child[0];
+		} /* for */
+		if (count < 2)
+			task->kind = taskRENDER;
+
+		if (task->kind == taskSPLIT) {
+			/* the header lines of the elements down to it */
+			context = task->arg[2];
+			for (d = 0; d <= depth; d++) {
+				berReadHeader (mf.data + path[d], flength - path[d], &hdr);
+				context = schemaChild (context, hdr.cl, hdr.tag, &info);
+				PrintHeader (path[d], path[d] + hdr.hdrlen, ecFindEnd (&endcache, mf.data, flength, path[d]),
+							 hdr.tag, hdr.cl, hdr.pc, hdr.taglen, hdr.length, &info);
+				indent++;
+			} /* for */
+
+			/* the children in subtasks, pushed last first so the first are run first */
+			if ((subs = malloc (count * sizeof(WpTask *))) != NULL) {	/* a subtask has a child or more */
+				sub = task;
+				for (n = 0, first = 0, i = 1; i <= count; i++)
+					if (i == count || child[i] - child[first] >= BATCHSIZE) {
+						if ((subs[n] = wpSpawn (pool, sub, taskRENDER, child[first], child[i], context, indent)) == NULL)
+							break;
+						sub = subs[n++];
+						first = i;
+					}
+				if (i > count) {
+					while (n > 0 && wpPush (pool, subs[n - 1]) == 0)
+						n--;
+					if (n == 0) {
+						free (subs);
+						free (child);
+						return;
+					}
 				}
-				length-= (length != -1) ? l : 0;
-			} /* while */
-			indent--;
+				while (n > 0)			/* the subtasks which weren't pushed */
+					wpCancel (pool, subs[--n]);
+				free (subs);
+			} /* if */
+			obPrintf (out, "at position %ld: not enough memory\n", task->arg[0]);
+			task->status = wpERROR;
+			free (child);
+			return;
 		} /* if */
+		free (child);
+		out->length = 0;
+		indent = (int)task->arg[3];
 	} /* if */
-	if (cl==asnCONTEXT && !do_context && pc!=asnCONSTRUCTED) {
-		indent++;
-		PrintIndent ();
-		printf ("(skipping %ld Bytes: ", length);
-		//asnSkipFile (length);
 
-		for (i = 0; i < length; i++) {
-			if (asnRead(&buffer, 1) == -1)
+	/* render the elements, stop like the sequential renderer does */
+	for (pos = task->arg[0]; pos < task->arg[1] && pos >= 0; ) {
+		tlvReset (&tree);
+		pos = tlvParse (&tree, pos, flength, -1, 0);
+		if (tree.count > 0)
+			AnalyseTag (0, task->arg[2]);
+		if (pos == tlvNOMEM || out->failed) {
+			task->status = wpNOMEM;
+			break;
+		} else if (pos == tlvERROR) {
+			obPrintf (out, "at position %ld: unexpected length (%ld) encountered\n", tree.errpos, tree.errlen);
+			task->status = wpERROR;
+		} else if (pos == tlvEOF) {
+			obPrintf (out, "at position %ld: incomplete element at end of data\n", tree.errpos);
+			task->status = wpERROR;
+		}
+	} /* for */
+}
+
+
+/*
+ * Find the children of the constructed element at pos by their headers.
+ * *child is set to an array with the offsets of the children followed by
+ * the end of the last one. Returns -1 if the children can't be told
+ * apart without parsing, 0 otherwise.
+ */
+
+static long FindChildren (long pos, long **child, long *count, long *size) {
+	BerHeader	 hdr;
+	long		 end,
+				 next,
+				*p;
+
+	if (berReadHeader (mf.data + pos, flength - pos, &hdr) < 0 || hdr.pc != berCONSTRUCTED)
+		return -1;
+	end = (hdr.length != -1) ? pos + hdr.hdrlen + hdr.length : flength;
+	*count = 0;
+	for (pos += hdr.hdrlen; ; pos = next) {
+		if (*count + 1 >= *size || *child == NULL) {
+			*size = *size ? 2 * *size : 1024;
+			if ((p = realloc (*child, *size * sizeof(long))) == NULL)
 				return -1;
-			if (isprint(buffer) && buffer != '\t')
-				printf ("%c", buffer);
-			else
-				printf ("{%02X}", buffer);
+			*child = p;
+		} /* if */
+		(*child)[*count] = pos;
+		if (hdr.length != -1 && pos == end)
+			return 0;
+		if (pos + 1 < end && mf.data[pos] == 0 && mf.data[pos + 1] == 0)
+			return (hdr.length == -1) ? 0 : -1;		/* end-of-contents */
+		if ((next = ecFindEnd (&endcache, mf.data, end, pos)) < 0)
+			return -1;
+		(*count)++;
+	} /* for */
+}
+
+
+/*
+ * Render for a client of the server, on a thread of the server: the
+ * elements in data from pos on, count elements or all if count is -1,
+ * with the switches of the server and the flags of the request.
+ */
+
+static int ServeRender (const byte *data, long length, long pos, long count, const char *flags, OutBuf *buf) {
+	long	 n;
+
+	if (SetSwitches (flags) == -1)
+		return -2;
+	if (pos < 0 || pos > length)
+		return -1;
+	SetWidth (length);
+	if (tree.data == NULL) {
+		tlvInit (&tree, data, length);
+		tree.maxdepth = maxdepth;
+		tree.maxnodes = maxnodes;
+	}
+	tree.data = data;
+	tree.dlength = length;
+	out = buf;
+	indent = 0;
+
+	for (n = 0; pos < length && pos >= 0 && n != count; ) {
+		tlvReset (&tree);
+		pos = tlvParse (&tree, pos, length, -1, 0);
+		if (tree.count > 0) {
+			AnalyseTag (0, rootcontext);
+			n++;
 		}
-		printf(")\n");
-		indent--;
-		return glen;
+		if (pos == tlvNOMEM)
+			out->failed = 1;
+		if (out->failed)
+			break;
+		if (pos == tlvERROR)
+			obPrintf (out, "at position %ld: unexpected length (%ld) encountered\n", tree.errpos, tree.errlen);
+		else if (pos == tlvEOF)
+			obPrintf (out, "at position %ld: incomplete element at end of data\n", tree.errpos);
+	} /* for */
+	return 0;
+}
+
+
+/*
+ * Let the server at socket render the file fn: send its content from
+ * -offset on, or its path and -offset with -bypath, and the switches which
+ * the request can turn on. Returns 0, 1 if the server answered
+ * with an error and 2 if it can't be reached.
+ */
+
+static int ServeRequest (const char *socket, const char *fn) {
+	OutBuf	 answer;
+	char	 request[4096],
+			 path[4096],
+			 flags[64],
+			*list;
+	int		 rc;
+
+	obInit (&answer);
+	/* the switches given here are sent along with the request */
+	sprintf (flags, "%s%s%s%s", given.context ? ",context" : "", given.octhex ? ",octhex" : "",
+				given.prtoffset ? ",prtoffset" : "", given.oidnames ? ",oids" : "");
+	list = flags + (flags[0] == ',');
+	if (do_bypath) {
+		if (realpath (fn, path) == NULL) {
+			fprintf (stderr, "asn1dump: can't open file '%s'\n", fn);
+			return 2;
+		}
+		sprintf (request, "FILE %ld -1 %s%s%.4000s", offset, list, list[0] != '\0' ? " " : "", path);
+		rc = srvCall (socket, request, NULL, 0, &answer);
+	} else {
+		if (mapOpen (&mf, fn) == -1) {
+			fprintf (stderr, "asn1dump: can't open file '%s'\n", fn);
+			return 2;
+		}
+		if (offset < 0 || offset > mf.length)
+			offset = mf.length;
+		sprintf (request, "BER %ld%s%s", mf.length - offset, list[0] != '\0' ? " " : "", list);
+		rc = srvCall (socket, request, mf.data + offset, mf.length - offset, &answer);
+		mapClose (&mf);
+	} /* if */
+
+	if (rc == srvFAILED) {
+		fprintf (stderr, "asn1dump: no answer from the server at '%s'\n", socket);
+		return 2;
+	}
+	obFlush (&answer, rc == srvOK ? stdout : stderr);
+	obFree (&answer);
+	return rc == srvOK ? 0 : 1;
+}
+
+
+/*
+ * Set the switches of the renderer of this thread to the ones given on
+ * the command line, and turn on those in flags, a comma separated list
+ * like "context,oids". Returns -1 for an unknown flag.
+ */
+
+static int SetSwitches (const char *flags) {
+	static const char	*names[] = { "context", "octhex", "prtoffset", "oids" };
+	size_t				 n;
+	int					 i;
+
+	do_context = given.context;
+	do_octhex = given.octhex;
+	do_prtoffset = given.prtoffset;
+	do_oidnames = given.oidnames;
+	for (; flags != NULL && *flags != '\0'; flags += n + (flags[n] == ',')) {
+		n = strcspn (flags, ",");
+		for (i = 0; i < 4 && (strlen (names[i]) != n || strncmp (flags, names[i], n) != 0); i++)
+			;
+		switch (i) {
+			case 0:
+				do_context = 1;
+				break;
+			case 1:
+				do_octhex = 1;
+				break;
+			case 2:
+				do_prtoffset = 1;
+				break;
+			case 3:
+				do_oidnames = 1;
+				break;
+			default:
+				return -1;
+		} /* switch */
+	} /* for */
+	return 0;
+}
+
+
+/*
+ * Set the width of the offsets shown, so that the columns line up for
+ * offsets up to length: the digits of length, at least 8.
+ */
+
+static void SetWidth (long length) {
+	long	 base;
+
+	base = (offsetbase == 16) ? 16 : 10;
+	for (offsetwidth = 1; length >= base; length /= base)
+		offsetwidth++;
+	if (offsetwidth < 8)
+		offsetwidth = 8;
+}
+
+
+/*
+ * Check the encoding of all elements without showing them. Every element
+ * is parsed strictly into its tree and the tree checked in one pass over
+ * the nodes. Returns 0 if the file is valid, 1 if not.
+ */
+
+static int Validate (int der) {
+	long	 pos,
+			 next,
+			 checked,
+			 violations;
+	int		 padding;
+
+	checked = 0;
+	violations = 0;
+	padding = 0;
+	for (pos = offset; pos < flength; pos = next) {
+		raAdvance (&readahead, pos);
+		if (pos + 1 < flength && mf.data[pos] == 0 && mf.data[pos + 1] == 0) {
+			if (der && !padding++) {		/* report each run of padding once */
+				CheckReportViolation (pos, chkPADDING, NULL);
+				violations++;
+			}
+			next = pos + 2;
+			continue;
+		} /* if */
+		padding = 0;
+		if (sampling && !Sampled (pos) && (next = ecFindEnd (&endcache, mf.data, flength, pos)) > pos)
+			continue;
+
+		tlvReset (&tree);
+		next = tlvParse (&tree, pos, flength, -1, 1);
+		if (next == tlvNOMEM) {
+			fprintf (stderr, "asn1dump: not enough memory\n");
+			return 1;
+		} /* if */
+		if (next == tlvERROR) {
+			printf ("at position %ld: unexpected length (%ld) encountered\n", tree.errpos, tree.errlen);
+			return 1;
+		} /* if */
+		if (next == tlvEOF) {
+			CheckReportViolation (pos, chkTRUNCATED, NULL);
+			return 1;
+		} /* if */
+		violations += chkTree (&tree, der, CheckReportViolation, NULL);
+		checked++;
+	} /* for */
+
+	if (do_stats && sampling)
+		fprintf (stderr, "asn1dump: %ld of %ld elements sampled\n", checked, scanned);
+	if (do_stats)
+		fprintf (stderr, "asn1dump: %ld violations of %s\n", violations, der ? "DER" : "BER");
+	return violations > 0 ? 1 : 0;
+}
+
+
+/*
+ * Find the top-level element at *pos, or behind the padding there. *pos is
+ * set to its start, hdr (if not NULL) to its header. Returns the offset
+ * behind the element or tlvEOF at the end of the file.
+ * The end of an element of definite length is taken from its header, the
+ * end of an indefinite length element is found by its headers only.
+ */
+
+static long NextElement (long *pos, BerHeader *hdr) {
+	BerHeader	 h;
+	long		 next;
+
+	if (hdr == NULL)
+		hdr = &h;
+	while (*pos + 1 < flength && mf.data[*pos] == 0 && mf.data[*pos + 1] == 0)
+		*pos += 2;			/* padding */
+	if (*pos >= flength)
+		return tlvEOF;
+
+	if (berReadHeader (mf.data + *pos, flength - *pos, hdr) > 0 && 
+		hdr->length != -1 && hdr->length <= flength - *pos - hdr->hdrlen)
+		return *pos + hdr->hdrlen + hdr->length;
+	if (hdr->length == -1 && (next = ecFindEnd (&endcache, mf.data, flength, *pos)) > 0)
+		return next;
+
+	/* incomplete or invalid, let the parser tell */
+	tlvReset (&tree);
+	next = tlvParse (&tree, *pos, flength, -1, 0);
+	if (next == tlvERROR) {
+		printf ("at position %ld: unexpected length (%ld) encountered\n", tree.errpos, tree.errlen);
+		exit (1);
+	} /* if */
+	if (next == tlvEOF) {
+		fprintf (stderr, "asn1dump: at position %ld: incomplete element at end of data\n", tree.errpos);
+		exit (1);
+	} /* if */
+	if (next == tlvNOMEM) {
+		fprintf (stderr, "asn1dump: not enough memory\n");
+		exit (1);
+	} /* if */
+	return next;
+}
+
+
+/*
+ * Copy the selected top-level elements unchanged to stdout: a range of
+ * element numbers "N", "N-M" or "N-", or the elements with a tag, e.g.
+ * "A[1]" or "U[16]". Neighbouring elements are copied with one call of
+ * mapCopy(), so the data doesn't pass through this process where the
+ * kernel can copy it. Returns 0 on success, 1 on errors.
+ */
+
+static int Extract (const char *sel) {
+	static char	 classes[] = "UACP";
+	BerHeader	 hdr;
+	long		 pos,
+				 next,
+				 first,
+				 last,
+				 number,
+				 start,
+				 end,
+				 count,
+				 tag;
+	char		 c,
+				*e;
+	int			 cl,
+				 selected;
+
+	cl = -1;
+	tag = first = last = 0;
+	if (sscanf (sel, "%c[%ld]", &c, &tag) == 2 && (e = strchr (classes, toupper (c))) != NULL)
+		cl = (int)(e - classes);
+	else {
+		first = last = strtol (sel, &e, 10);
+		if (*e == '-')
+			last = (*++e == '\0') ? -1 : strtol (e, &e, 10);
+		if (*e != '\0' || first < 1 || (last != -1 && last < first)) {
+			fprintf (stderr, "asn1dump: bad selection '%s' for -extract\n", sel);
+			return 1;
+		}
+	} /* else */
+	if (isatty (fileno (stdout))) {
+		fprintf (stderr, "asn1dump: -extract writes BER data, please redirect the output\n");
+		return 1;
+	} /* if */
+	fflush (stdout);
+
+	start = end = 0;
+	count = 0;
+	for (pos = offset, number = 1; (next = NextElement (&pos, &hdr)) != tlvEOF; pos = next, number++) {
+		if (cl != -1)
+			selected = (hdr.cl == cl && hdr.tag == tag);
+		else if (number > last && last != -1)
+			break;
+		else
+			selected = (number >= first);
+		if (!selected)
+			continue;
+
+		if (pos != end) {		/* not adjacent to the previous one */
+			if (end > start && mapCopy (&mf, start, end - start, fileno (stdout)) == -1) {
+				perror ("asn1dump: can't write elements");
+				return 1;
+			}
+			start = pos;
+		}
+		end = next;
+		count++;
+	} /* for */
+
+	if (end > start && mapCopy (&mf, start, end - start, fileno (stdout)) == -1) {
+		perror ("asn1dump: can't write elements");
+		return 1;
+	} /* if */
+	if (do_stats)
+		fprintf (stderr, "asn1dump: %ld elements extracted\n", count);
+	return 0;
+}
+
+
+/*
+ * Aggregate the values at the comma separated paths of the elements: only
+ * the tree of each top-level element is built, and only the subtrees on a
+ * path are visited. Returns 0, 1 if an element is broken and 2 for a bad
+ * path.
+ */
+
+# define	MAXAGGREGATES	32		/* paths, one bit each in a mask			*/
+
+static int AggregateValues (const char *paths) {
+	Aggregate	*ag;
+	const char	*p,
+				*e;
+	long		 pos,
+				 next,
+				 elements;
+	int			 count,
+				 i,
+				 rc;
+
+	if ((ag = malloc (MAXAGGREGATES * sizeof(Aggregate))) == NULL) {
+		fprintf (stderr, "asn1dump: not enough memory\n");
+		return 2;
 	}
+	for (count = 0, p = paths; ; p = e + 1) {
+		if ((e = strchr (p, ',')) == NULL)
+			e = p + strlen (p);
+		if (count == MAXAGGREGATES || agParse (&ag[count], p, (long)(e - p)) == -1) {
+			fprintf (stderr, "asn1dump: bad path '%.*s' for -aggregate\n", (int)(e - p), p);
+			free (ag);
+			return 2;
+		}
+		count++;
+		if (*e == '\0')
+			break;
+	} /* for */
+
+	rc = 0;
+	elements = 0;
+	for (pos = offset; pos < flength && pos >= 0; pos = next) {
+		raAdvance (&readahead, pos);
+		if (sampling && !Sampled (pos) && (next = ecFindEnd (&endcache, mf.data, flength, pos)) > pos)
+			continue;
+		tlvReset (&tree);
+		next = tlvParse (&tree, pos, flength, -1, 0);
+		if (tree.count > 0) {
+			AggregateNode (ag, count, 0, 0, (1UL << count) - 1);
+			elements++;
+		}
+		if (next == tlvNOMEM) {
+			fprintf (stderr, "asn1dump: not enough memory\n");
+			rc = 1;
+			break;
+		} else if (next == tlvERROR) {
+			fprintf (stderr, "asn1dump: at position %ld: unexpected length (%ld) encountered\n", tree.errpos, tree.errlen);
+			rc = 1;
+		} else if (next == tlvEOF) {
+			fprintf (stderr, "asn1dump: at position %ld: incomplete element at end of data\n", tree.errpos);
+			rc = 1;
+		} /* if */
+	} /* for */
+
+	for (i = 0; i < count; i++)
+		agPrint (&ag[i], stdout);
+	if (do_stats)
+		fprintf (stderr, "asn1dump: %ld elements aggregated\n", elements);
+	free (ag);
+	return rc;
+}
+
+
+/*
+ * Add the value of node at depth to the aggregates in mask whose path
+ * ends there, and visit the children for those whose path goes on.
+ */
+
+static void AggregateNode (Aggregate *ag, int count, long node, int depth, unsigned long mask) {
+	unsigned long	 deeper;
+	long			 child;
+	int				 cl,
+					 i;
+
+	cl = tlvClass (&tree, node);
+	deeper = 0;
+	for (i = 0; i < count; i++) {
+		if (!(mask & (1UL << i)) || !agMatch (&ag[i], depth, cl, tree.tag[node]))
+			continue;
+		if (depth + 1 < ag[i].depth)
+			deeper |= 1UL << i;
+		else if (tlvPc (&tree, node) == berPRIMITIVE)
+			agAdd (&ag[i], cl, tree.tag[node], tlvContent (&tree, node), tlvContentLength (&tree, node));
+	} /* for */
+
+	if (deeper != 0 && tlvPc (&tree, node) == berCONSTRUCTED)
+		for (child = tree.child[node]; child != -1; child = tree.next[child])
+			AggregateNode (ag, count, child, depth + 1, deeper);
+}
+
+
+/*
+ * Print a hash of the encoding of each element and/or report duplicate
+ * elements. Returns 1 if there are duplicates, 0 if not.
+ */
 
-	return glen;
+static int HashRecords (void) {
+	HashSet		 set;
+	hash64		 hash;
+	long		 pos,
+				 next,
+				 first,
+				 records,
+				 duplicates;
+
+	hsInit (&set, mf.data);
+	records = duplicates = 0;
+	for (pos = offset; (next = NextElement (&pos, NULL)) != tlvEOF; pos = next) {
+		raAdvance (&readahead, pos);
+		hash = hashXXH64 (mf.data + pos, next - pos, 0);
+		records++;
+		if (do_hash)
+			printf ("%08ld %016llx %ld\n", pos, hash, next - pos);
+		if (do_dups) {
+			if ((first = hsInsert (&set, hash, pos, next - pos)) == -2) {
+				fprintf (stderr, "asn1dump: not enough memory for the set of elements\n");
+				exit (1);
+			} /* if */
+			if (first >= 0) {
+				printf ("at position %ld: duplicate of the element at position %ld\n", pos, first);
+				duplicates++;
+			} /* if */
+		} /* if */
+	} /* for */
+
+	if (do_stats)
+		fprintf (stderr, "asn1dump: %ld elements, %ld duplicates\n", records, duplicates);
+	hsFree (&set);
+	return duplicates > 0 ? 1 : 0;
+}
+
+
+/*
+ * Hexdump of the file with the structure: each header gets a line with
+ * its bytes, level and tag, the content of primitive elements follows in
+ * rows of 16 bytes. The headers are read in one pass, the nesting is kept
+ * on a stack of the ends of the open constructed elements. Returns 1 if
+ * there are bytes which aren't ASN.1, 0 if not.
+ */
+
+typedef struct {
+	long		 end;			/* end of the content, -1 if up to an EOC	*/
+	long		 bound;			/* the content can't go beyond this		*/
+} HexLevel;
+
+static int HexStructure (int method) {
+	BerHeader	 hdr;
+	HexLevel	*level,
+				*more;
+	const char	*name;
+	long		 pos,
+				 n,
+				 bound,
+				 length;
+	int			 depth,
+				 size,
+				 rc;
+
+	if ((sink = skOpen (stdout, method)) == NULL || (level = malloc (64 * sizeof(HexLevel))) == NULL) {
+		fprintf (stderr, "asn1dump: not enough memory\n");
+		return 1;
+	}
+	size = 64;
+	out = &stdoutbuf;
+	depth = 0;
+	rc = 0;
+	level[0].end = level[0].bound = flength;
+	for (pos = offset; ; ) {
+		while (depth > 0 && pos >= level[depth].bound) {
+			if (level[depth].end == -1) {
+				/* indefinite length, but its enclosing element or the data ended */
+				HexRow (pos, 0, depth);
+				obWrite (out, "(missing end-of-contents)\n", 26);
+				rc = 1;
+			}
+			depth--;
+		} /* while */
+		if (pos >= flength)
+			break;
+		bound = level[depth].bound;
+		if (depth == 0)
+			raAdvance (&readahead, pos);
+
+		if (berReadHeader (mf.data + pos, bound - pos, &hdr) < 0 ||
+			(hdr.length == -1 && hdr.pc == berPRIMITIVE) ||
+			hdr.length > bound - pos - hdr.hdrlen) {
+			/* show the rest of the enclosing element as it is */
+			length = (bound - pos < 16) ? bound - pos : 16;
+			HexRow (pos, length, depth);
+			obPrintf (out, "(%ld Bytes which aren't ASN.1)\n", bound - pos);
+			for (pos += length; pos < bound; pos += length) {
+				length = (bound - pos < 16) ? bound - pos : 16;
+				HexRow (pos, -length, depth + 1);
+			}
+			rc = 1;
+			continue;
+		} /* if */
+
+		/* the header, wrapped if it's longer than a row */
+		for (n = 0; n < hdr.hdrlen; n += length) {
+			length = (hdr.hdrlen - n < 16) ? hdr.hdrlen - n : 16;
+			HexRow (pos + n, length, depth);
+			if (n == 0 && berIsEOC (&hdr))
+				obWrite (out, "EOC", 3);
+			else if (n == 0) {
+				name = Tag2String (hdr.tag, hdr.cl);
+				obWrite (out, name, (long)strlen (name));
+				obWrite (out, " ", 1);
+				obWrite (out, clpcnames[(hdr.cl << 1 | hdr.pc) & 7], (long)strlen (clpcnames[(hdr.cl << 1 | hdr.pc) & 7]));
+				if (hdr.length == -1)
+					obWrite (out, " length= indefinite", 19);
+				else {
+					obWrite (out, " length= ", 9);
+					obLong (out, hdr.length, 0);
+				}
+			}
+			obWrite (out, "\n", 1);
+		} /* for */
+		pos += hdr.hdrlen;
+
+		if (berIsEOC (&hdr)) {
+			if (depth > 0 && level[depth].end == -1)
+				depth--;				/* the end of an indefinite length element */
+		} else if (hdr.pc == berCONSTRUCTED) {
+			if (depth + 1 >= size) {
+				if ((more = realloc (level, 2 * (size_t)size * sizeof(HexLevel))) == NULL) {
+					fprintf (stderr, "asn1dump: not enough memory\n");
+					rc = 1;
+					break;
+				}
+				level = more;
+				size *= 2;
+			} /* if */
+			depth++;
+			level[depth].end = (hdr.length == -1) ? -1 : pos + hdr.length;
+			level[depth].bound = (hdr.length == -1) ? bound : pos + hdr.length;
+		} else {
+			/* the content in rows of 16 bytes */
+			for (n = 0; n < hdr.length; n += length) {
+				length = (hdr.length - n < 16) ? hdr.length - n : 16;
+				HexRow (pos + n, -length, depth + 1);
+			}
+			pos += hdr.length;
+		} /* if */
+
+		if (out->failed) {
+			fprintf (stderr, "asn1dump: not enough memory\n");
+			rc = 1;
+			break;
+		} /* if */
+		if (out->length >= FLUSHSIZE)
+			skFlush (sink, out);
+	} /* for */
+
+	skFlush (sink, out);
+	if (skClose (sink, NULL, NULL) == EOF) {
+		fprintf (stderr, "asn1dump: can't write the output\n");
+		rc = 1;
+	}
+	free (level);
+	return rc;
+}
+
+/*
+ * print the offset and the hex of a row of n bytes at pos, then the level
+ * and the indent. If n is negative the row is content, which is followed
+ * by its characters and the newline.
+ */
+
+static void HexRow (long pos, long n, long depth) {
+	char		 line[80],
+				*p;
+	const byte	*data;
+	long		 i,
+				 count,
+				 level;
+
+	data = mf.data + pos;
+	level = depth;
+	count = (n < 0) ? -n : n;
+	p = line;
+	for (i = 0; i < 16; i++) {
+		if (i == 8)
+			*p++ = ' ';
+		memcpy (p, (i < count) ? hexpairs[data[i]] : "   ", 3);
+		p += 3;
+	}
+	obHex (out, (unsigned long)pos, 8);
+	obWrite (out, "  ", 2);
+	obWrite (out, line, p - line);
+	if (n < 0)
+		obWrite (out, "      ", 6);
+	else {
+		p = line + 6;
+		*--p = ' ';
+		*--p = ' ';
+		do {
+			*--p = (char)('0' + depth % 10);
+			depth /= 10;
+		} while (depth != 0 && p > line);
+		while (p > line + 1)
+			*--p = ' ';
+		obWrite (out, p, line + 6 - p);
+	}
+	obWrite (out, spaces, (3 * level < (long)sizeof(spaces) - 1) ? 3 * level : (long)sizeof(spaces) - 1);
+	if (n < 0) {
+		p = line;
+		*p++ = '|';
+		for (i = 0; i < count; i++)
+			*p++ = (data[i] > ' ' && data[i] < 0x7F) ? (char)data[i] : '.';
+		*p++ = '|';
+		*p++ = '\n';
+		obWrite (out, line, p - line);
+	}
+}
+
+
+/*
+ * print a violation of the encoding rules
+ */
+
+static void CheckReportViolation (long pos, int rule, void *arg) {
+	printf ("at position %ld: %s\n", pos, chkMessage (rule));
+	(void)arg;
+}
+
+
+/*
+ * Render a node of the tree and all its children. context is the schema
+ * context of the parent, or -1 if there is no schema.
+ */
+
+static void AnalyseTag (long node, long context) {
+	SchemaInfo	 info;
+	long		 child,
+				 last,
+				 pos,
+				 length;
+	int			 cl,
+				 pc;
+
+	cl = tlvClass (&tree, node);
+	pc = tlvPc (&tree, node);
+	context = schemaChild (context, cl, tree.tag[node], &info);
+	last = -1;
+
+	PrintHeader (tree.offset[node], tlvContentOffset (&tree, node), tree.end[node], tree.tag[node], cl, pc, 
+				 tree.taglen[node], tree.length[node], &info);
+	if (out == &stdoutbuf && out->length >= FLUSHSIZE && !out->failed)
+		skFlush (sink, out);		/* don't keep the text of a big element */
+
+	if (pc == berPRIMITIVE) {
+		if (cl == berUNIVERSAL)
+			ShowValue (node, (int)tree.tag[node]);
+		else if (info.utag != -1)
+			ShowValue (node, info.utag);	/* the schema knows the type */
+		else if (do_context && tlvParseContent (&tree, node) == 0)
+			pc = berCONSTRUCTED;	/* content decoded, show it as children */
+		else
+			SkipValue (node);
+	} /* if */
+
+	if (pc == berCONSTRUCTED) {
+		indent++;
+		if (tree.child[node] == tlvSKIPPED)
+			NotShown (tlvContentOffset (&tree, node), tlvContentLength (&tree, node), "-maxdepth", maxdepth);
+		else {
+			for (child = tree.child[node]; child != -1 && !out->failed; child = tree.next[child]) {
+				AnalyseTag (child, context);		/* Recursion !! */
+				last = child;
+			}
+			if (tree.cutpos != -1 && tree.offset[node] < tree.cutpos && tree.end[node] > tree.cutpos) {
+				/* open when -maxnodes stopped the parser */
+				pos = (last != -1 && tree.end[last] > tree.cutpos) ? tree.end[last] : tree.cutpos;
+				length = tlvContentOffset (&tree, node) + tlvContentLength (&tree, node) - pos;
+				if (length > 0)
+					NotShown (pos, length, "-maxnodes", maxnodes);
+			}
+		} /* else */
+		indent--;
+	} /* if */
+}
+
+
+/*
+ * print a summary of content which isn't shown because of a limit
+ */
+
+static void NotShown (long pos, long length, const char *limit, long value) {
+	PrintIndent (pos);
+	obPrintf (out, "(%ld Bytes not shown, %s %ld)\n", length, limit, value);
+}
+
+
+/*
+ * print the header line of an element, which starts at start, has its
+ * content at pos and ends at end
+ */
+
+static void PrintHeader (long start, long pos, long end, long tag, int cl, int pc, int taglen, long length, SchemaInfo *info) {
+	const char	*s;
+
+	if (offsetbase == 16) {
+		obHex (out, (unsigned long)start, offsetwidth);
+		obWrite (out, " ", 1);
+		obHex (out, (unsigned long)pos, offsetwidth);
+		obWrite (out, " ", 1);
+		obHex (out, (unsigned long)end, offsetwidth);
+		obWrite (out, " - ", 3);
+		PrintLevel ();
+	} else if (offsetbase == 10) {
+		obLong (out, start, offsetwidth);
+		obWrite (out, " ", 1);
+		obLong (out, pos, offsetwidth);
+		obWrite (out, " ", 1);
+		obLong (out, end, offsetwidth);
+		obWrite (out, " - ", 3);
+		PrintLevel ();
+	} else
+		PrintIndent (pos);
+	s = Tag2String (tag, cl);
+	obWrite (out, s, (long)strlen (s));
+	obWrite (out, " (taglength= ", 13);
+	obLong (out, taglen, 0);
+	obWrite (out, " length= ", 9);
+	obLong (out, length, 0);
+	obWrite (out, ") ", 2);
+	s = clpcnames[(cl << 1 | pc) & 7];
+	obWrite (out, s, (long)strlen (s));
+	PrintSchemaInfo (info);
+}
+
+
+/*
+ * print the component and type name from the schema
+ */
+
+static void PrintSchemaInfo (SchemaInfo *info) {
+	if (info->field || info->alt || info->type) {
+		obPrintf (out, "  --");
+		if (info->field)
+			obPrintf (out, " %.*s", info->fieldlen, info->field);
+		if (info->alt)
+			obPrintf (out, "%s%.*s", info->field ? "." : " ", info->altlen, info->alt);
+		if (info->type)
+			obPrintf (out, "%s%.*s", (info->field || info->alt) ? " : " : " ", info->typelen, info->type);
+	} /* if */
+	obWrite (out, "\n", 1);
 }
 
 
@@ -193,228 +1721,543 @@ static long AnalyseTag (void) {
  * display the coded value
  */
 
-static long ShowValue (byte tag, byte cl, byte pc, long length) {
-	long	 l, ll,
-			 longvalue;
-	byte	 buffer[256],
-			 bytevalue;
+# define	MAXDECIMALINT	256		/* longer integers are shown in hex		*/
+
+static void ShowValue (long node, int tag) {
+	const byte	*content;
+	long		 length,
+				 longvalue,
+				 i;
+	int			 boolvalue,
+				 size,
+				 width;
+	double		 realvalue;
+	char		*buffer,
+				 timebuffer[48];
+	const char	*name;
+	unsigned long	*work;
+
+	content = tlvContent (&tree, node);
+	length  = tlvContentLength (&tree, node);
+
+	indent++;
+	if (maxvalue > 0 && length > maxvalue) {	/* not decoded, the start is shown */
+		PrintIndent (tlvContentOffset (&tree, node) + length);
+		PrintOctets (content, length, 0);
+		indent--;
+		return;
+	} /* if */
+	switch (tag) {
+		case berBOOLEAN:
+			if (berGetBoolean (content, length, &boolvalue) == -1)
+				break;
+			PrintIndent (tlvContentOffset (&tree, node) + length);
+			obPrintf (out, "::= %s\n", boolvalue ? "TRUE" : "FALSE");
+			break;
+
+		case berINTEGER:
+		case berENUMERATED:
+			PrintIndent (tlvContentOffset (&tree, node) + length);
+			if (berGetInteger (content, length, &longvalue) == 0) {
+				obPrintf (out, "::= %ld\n", longvalue);
+				break;
+			} /* if */
+			/* too long for a long */
+			buffer = arenaAlloc (&tree.arena, 3 * length + 4);
+			work = arenaAlloc (&tree.arena, ((length + 3) / 4) * sizeof(unsigned long));
+			if (buffer == NULL || work == NULL ||
+				(longvalue = berGetBigInteger (content, length, length > MAXDECIMALINT, 
+											   buffer, 3 * length + 4, work)) == -1)
+				PrintOctets (content, length, 0);
+			else
+				obPrintf (out, "::= %.*s\n", (int)longvalue, buffer);
+			break;
+
+		case berOCTETSTRING:
+		case berNUMERICSTRING:
+		case berPRINTABLESTRING:
+		case berTELETEXSTRING:
+		case berVIDEOTEXSTRING:
+		case berIA5STRING:
+		case berGRAPHICSTRING:
+		case berVISIBLESTRING:
+		case berGENERALSTRING:
+			PrintIndent (tlvContentOffset (&tree, node) + length);
+			PrintOctets (content, length, 0);
+			break;
+
+		case berUTF8STRING:
+		case berBMPSTRING:
+		case berUNIVERSALSTRING:
+			width = (tag == berUTF8STRING) ? 1 : (tag == berBMPSTRING) ? 2 : 4;
+			buffer = arenaAlloc (&tree.arena, 2 * length + 1);
+			PrintIndent (tlvContentOffset (&tree, node) + length);
+			if (do_octhex || buffer == NULL || 
+				(longvalue = berGetUnicode (content, length, width, buffer, 2 * length)) == -1)
+				PrintOctets (content, length, 0);
+			else
+				PrintOctets ((byte *)buffer, longvalue, 1);
+			break;
+
+		case berBITSTRING:
+			PrintIndent (tlvContentOffset (&tree, node) + length);
+			if ((longvalue = berGetBitString (content, length)) == -1)
+				PrintOctets (content, length, 0);
+			else if (longvalue <= 64 && !do_octhex) {
+				obPrintf (out, "::= '");
+				for (i = 0; i < longvalue; i++)
+					obPrintf (out, "%c", (content[1 + i / 8] & (0x80 >> (i % 8))) ? '1' : '0');
+				obPrintf (out, "'B\n");
+			} else {
+				obPrintf (out, "::= ");
+				for (i = 1; i < length; i++)
+					obWrite (out, hexpairs[content[i]], 3);
+				obPrintf (out, "(%ld bits)\n", longvalue);
+			}
+			break;
+
+		case berUTCTIME:
+		case berGENERALIZEDTIME:
+			PrintIndent (tlvContentOffset (&tree, node) + length);
+			if (berGetTime (content, length, tag == berGENERALIZEDTIME, 
+							timebuffer, sizeof(timebuffer)) == -1)
+				PrintOctets (content, length, 0);
+			else
+				obPrintf (out, "::= %s\n", timebuffer);
+			break;
+
+		case berREAL:
+			PrintIndent (tlvContentOffset (&tree, node) + length);
+			if (berGetReal (content, length, &realvalue) == -1)
+				PrintOctets (content, length, 0);
+			else
+				obPrintf (out, "::= %.17g\n", realvalue);
+			break;
+
+		case berOBJECTID:
+			size = (length < 0x10000) ? (int)(21 * length + 64) : 0x10000;
+			buffer = arenaAlloc (&tree.arena, size);
+			if (buffer == NULL || berGetOid (content, length, buffer, size) == -1)
+				break;
+			PrintIndent (tlvContentOffset (&tree, node) + length);
+			if (do_oidnames && (name = oidLookup (content, length, &size)) != NULL)
+				obPrintf (out, "::= %s (%.*s)\n", buffer, size, name);
+			else
+				obPrintf (out, "::= %s\n",buffer);
+			break;
+
+		default:
+			break;
+	}
+	indent--;
+}
+
+
+/*
+ * print an octet string, printable parts as a string, others as hex.
+ * If utf8 is set the buffer holds valid UTF-8 and non-ASCII characters
+ * are printed as they are. Only the first -maxbytes-per-value bytes are
+ * printed.
+ */
+
+# define	SHOWN(c,utf8)	(!(isspace(c) && (c) != ' ') && (isprint(c) || ((utf8) && (c) >= 0x80)))
+
+static void PrintOctets (const byte *buffer, long l, int utf8) {
+	long	 ll,
+			 run,
+			 n;
 	int		 fl;
 
-	switch ((int)cl) {
-
-		case asnUNIVERSAL:	
-			printf ("\n");
-			indent++;
-			switch ((int)tag) {
-				case asnBOOLEAN:
-					if (asnReadBoolean (&bytevalue, (int)length) == -1)
-						return -1l;
-					PrintIndent ();
-					printf ("::= %s\n", (bytevalue==asnTRUE)?"TRUE":"FALSE");
-					indent--;
-					return length;
-
-				case asnINTEGER:
-					if (asnReadInteger (&longvalue, (int)length) == -1)
-						return -1l;
-					PrintIndent ();
-					printf ("::= %ld\n", longvalue);
-					indent--;
-					return length;
-
-				case asnENUMERATED:
-					if (asnReadEnum (&longvalue, (int)length) == -1)
-						return -1l;
-					PrintIndent ();
-					printf ("::= %ld\n", longvalue);
-					indent--;
-					return length;
-
-				case asnOCTETSTRING:
-				case asnNUMERICSTRING:
-				case asnPRINTABLESTRING:
-				case asnTELETEXSTRING:
-				case asnVIDEOTEXSTRING:
-				case asnIA5STRING:
-				case asnGRAPHICSTRING:
-				case asnVISIBLESTRING:
-				case asnGENERALSTRING:
-					if ((l= asnReadOctet (buffer, (int)length, 
-										  sizeof(buffer)-1, pc))==-1)
-						return -1l;
-					PrintIndent ();
-					printf ("::= ");
+	obWrite (out, "::= ", 4);
+	fl= 0;
+	n= (maxvalue > 0 && l > maxvalue) ? maxvalue : l;
+	for (ll=0; ll<n; ll++) {
+		if (do_octhex)
+			obWrite (out, hexpairs[buffer[ll]], 3);
+		else 
+			if (!SHOWN(buffer[ll], utf8)) {
+				if (fl) {
+					obWrite (out, "\" ", 2);
 					fl= 0;
-					for (ll=0; ll<l; ll++) {
-						if (do_octhex)
-							printf ("%02X ", buffer[ll]);
-						else 
-							if ((isspace(buffer[ll]) && buffer[ll] != ' ')|| !isprint(buffer[ll])) {
-								if (fl) {
-									printf ("\" ");
-									fl= 0;
-								} /* if */
-								printf ("%02X ", buffer[ll]);
-							} else {
-								if (!fl) {
-									printf ("\"");
-									fl= 1;
-								} /* if */
-								printf ("%c", buffer[ll]);
-							} /* else */
-					} /* for */
-					if (fl)
-						printf ("\"");
-					printf ("\n");
-					indent--;
-					return length;
-
-				case asnOBJECTID:
-					if (asnReadOid ((char *)buffer, (int)length) == -1)
-						return -1l;
-					PrintIndent ();
-					printf ("::= %s\n",buffer);
-					indent--;
-					return length;
-
-				case asnEXTERNAL:
-					indent--;
-					return 0;
-
-				case asnSEQUENCE:
-					indent--;
-					return 0;
-
-				case asnSET:
-					indent--;
-					return 0;
-
-				case asnNULLVALUE:
-					indent--;
-					return 0;
-				default:
-					indent--;
-					break;
-			}
-			asnSkipFile (length);
-			return length;
-
-		case asnAPPLICATION:
-		case asnPRIVATE:
-		case asnCONTEXT:
-			printf ("\n");
-			l= 0;
-			if (do_context || pc==asnCONSTRUCTED) {
-				indent++;
-				if ((l= AnalyseTag ()) == -1)	/* Recursion !! */
-					return -1l;
-				indent--;
+				} /* if */
+				obWrite (out, hexpairs[buffer[ll]], 3);
+			} else {
+				if (!fl) {
+					obWrite (out, "\"", 1);
+					fl= 1;
+				} /* if */
+				for (run= ll + 1; run < n && SHOWN(buffer[run], utf8); run++)
+					;
+				obWrite (out, (const char *)buffer + ll, run - ll);
+				ll= run - 1;
+			} /* else */
+	} /* for */
+	if (fl)
+		obWrite (out, "\"", 1);
+	if (n < l)
+		obPrintf (out, " ... (%ld of %ld Bytes shown)", n, l);
+	obWrite (out, "\n", 1);
+}
+
+
+/*
+ * show the content of a tag which isn't decoded
+ */
+
+static void SkipValue (long node) {
+	const byte	*content;
+	long		 i,
+				 n,
+				 run,
+				 length;
+
+	content = tlvContent (&tree, node);
+	length  = tlvContentLength (&tree, node);
+	n = (maxvalue > 0 && length > maxvalue) ? maxvalue : length;
+
+	indent++;
+	PrintIndent (tlvContentOffset (&tree, node));
+	obPrintf (out, "(skipping %ld Bytes: ", length);
+	for (i = 0; i < n; i++) {
+		if (isprint(content[i]) && content[i] != '\t') {
+			for (run = i + 1; run < n && isprint(content[run]) && content[run] != '\t'; run++)
+				;
+			obWrite (out, (const char *)content + i, run - i);
+			i = run - 1;
+		} else {
+			obWrite (out, "{", 1);
+			obWrite (out, hexpairs[content[i]], 2);
+			obWrite (out, "}", 1);
+		}
+	}
+	obPrintf (out, "%s)\n", n < length ? " ..." : "");
+	indent--;
+}
+
+
+/*
+ * print indent, after the offset with -prtoffset or below the offsets of
+ * the header lines with -offsets; PrintLevel() prints just the indent
+ */
+
+static void PrintIndent (long pos) {
+	if (offsetbase != 0)
+		obWrite (out, spaces, 3 * offsetwidth + 5);	/* below the three offsets */
+	else if (do_prtoffset) {
+		obLong (out, pos, offsetwidth);
+		obWrite (out, " - ", 3);
+	}
+	PrintLevel ();
+}
+
+static void PrintLevel (void) {
+	long	n,
+			k;
+
+	for (n = 3L * indent; n > 0; n -= k) {
+		k = (n < (long)sizeof(spaces) - 1) ? n : (long)sizeof(spaces) - 1;
+		obWrite (out, spaces, k);
+	}
+}
+	
+
+/*****************************************************************************
+ *
+ * Compare the elements of two files.
+ *
+ * Both files are walked in lockstep, header by header, without building
+ * trees. Elements whose encodings are the same byte for byte are skipped
+ * with one memcmp(), only the children of differing constructed elements
+ * are visited. Siblings are matched by position; if the tags of two
+ * siblings differ but the next sibling on one side matches, the element
+ * on the other side is reported as inserted.
+ * Returns 0 if the files are the same, 1 if they differ and 2 on errors.
+ */
+
+static int DiffFiles (const char *fna, const char *fnb) {
+	MappedFile	 mfa,
+				 mfb;
+	EndCache	 eca,
+				 ecb;
+	DiffCursor	 a,
+				 b;
+	int			 rc;
+
+	if (mapOpen (&mfa, fna) == -1) {
+		fprintf (stderr, "asn1dump: can't open file '%s'\n", fna);
+		return 2;
+	}
+	if (mapOpen (&mfb, fnb) == -1) {
+		fprintf (stderr, "asn1dump: can't open file '%s'\n", fnb);
+		mapClose (&mfa);
+		return 2;
+	}
+
+	if (ecInit (&eca, 0) == -1 || ecInit (&ecb, 0) == -1) {
+		fprintf (stderr, "asn1dump: not enough memory\n");
+		return 2;
+	}
+
+	memset (&a, 0, sizeof(a));
+	a.name   = "A";
+	a.data   = mfa.data;
+	a.length = mfa.length;
+	a.pos    = offset;
+	a.end    = mfa.length;
+	a.top    = 1;
+	a.index  = 1;
+	a.cache  = &eca;
+	b        = a;
+	b.name   = "B";
+	b.data   = mfb.data;
+	b.length = mfb.length;
+	b.end    = mfb.length;
+	b.cache  = &ecb;
+
+	rc = DiffList (&a, &b, NULL);
+
+	ecFree (&eca);
+	ecFree (&ecb);
+	mapClose (&mfa);
+	mapClose (&mfb);
+	if (rc == -1)
+		return 2;
+	return differences > 0 ? 1 : 0;
+}
+
+
+/*
+ * compare two lists of siblings
+ */
+
+static int DiffList (DiffCursor *a, DiffCursor *b, const DiffPath *up) {
+	DiffCursor	 next;
+	int			 ra,
+				 rb;
+
+	for (;;) {
+		if ((ra = DiffRead (a)) == -1 || (rb = DiffRead (b)) == -1)
+			return -1;
+		if (!ra && !rb)
+			return 0;
+
+		if (ra && rb && (a->hdr.cl != b->hdr.cl || a->hdr.tag != b->hdr.tag)) {
+			/* an inserted element on one side? */
+			if (DiffSkip (b) == -1 || DiffSkip (a) == -1)
+				return -1;
+			next       = *b;
+			next.pos   = b->elend;
+			next.index = b->index + 1;
+			if (DiffRead (&next) == 1 && next.hdr.cl == a->hdr.cl && next.hdr.tag == a->hdr.tag)
+				ra = 0;
+			else {
+				next       = *a;
+				next.pos   = a->elend;
+				next.index = a->index + 1;
+				if (DiffRead (&next) == 1 && next.hdr.cl == b->hdr.cl && next.hdr.tag == b->hdr.tag)
+					rb = 0;
 			}
-			return l;
+		} /* if */
 
-# ifdef NIE
-		case asnAPPLICATION:
-		case asnPRIVATE:	
-			printf (": unknown. %ld bytes skipped\n", length);
-			asnSkipFile (length);
-			return length;
-# endif
+		if (!ra || !rb) {
+			if (DiffSkip (ra ? a : b) == -1)
+				return -1;
+			DiffOnly (ra ? a : b, up);
+		} else if (DiffElement (a, b, up) == -1)
+			return -1;
+	} /* for */
+}
 
-	} /* switch */
 
+/*
+ * compare the current elements of two lists and move behind them
+ */
+
+static int DiffElement (DiffCursor *a, DiffCursor *b, const DiffPath *up) {
+	DiffPath	 path;
+	DiffCursor	 ca,
+				 cb;
+	long		 size;
+
+	path.up    = up;
+	path.tag   = a->hdr.tag;
+	path.cl    = a->hdr.cl;
+	path.index = a->index;
+
+	if (a->elend != -1 && (size = a->elend - a->pos) == b->elend - b->pos &&
+		memcmp (a->data + a->pos, b->data + b->pos, size) == 0)
+		;		/* the same, no need to look into it */
+
+	else if (a->hdr.tag != b->hdr.tag || a->hdr.cl != b->hdr.cl || a->hdr.pc != b->hdr.pc) {
+		if (DiffSkip (a) == -1 || DiffSkip (b) == -1)
+			return -1;
+		DiffPrintPath (&path);
+		printf (": element differs (A: %s %s at %ld; ", 
+				Tag2String (a->hdr.tag, a->hdr.cl), Pc2String (a->hdr.pc), a->pos);
+		printf ("B: %s %s at %ld)\n", 
+				Tag2String (b->hdr.tag, b->hdr.cl), Pc2String (b->hdr.pc), b->pos);
+		differences++;
+
+	} else if (a->hdr.pc == berPRIMITIVE) {
+		DiffPrintPath (&path);
+		printf (": value differs (A: at %ld, length %ld; B: at %ld, length %ld)\n",
+				a->pos, a->hdr.length, b->pos, b->hdr.length);
+		differences++;
+
+	} else {
+		/* walk the children, the end of an indefinite element is found on the way */
+		ca       = *a;
+		ca.pos   = a->pos + a->hdr.hdrlen;
+		ca.end   = (a->hdr.length != -1) ? a->elend : -1;
+		ca.top   = 0;
+		ca.index = 1;
+		cb       = *b;
+		cb.pos   = b->pos + b->hdr.hdrlen;
+		cb.end   = (b->hdr.length != -1) ? b->elend : -1;
+		cb.top   = 0;
+		cb.index = 1;
+		if (DiffList (&ca, &cb, &path) == -1)
+			return -1;
+		if (a->elend == -1)
+			a->elend = ca.pos + 2;
+		if (b->elend == -1)
+			b->elend = cb.pos + 2;
+	}
+
+	a->pos = a->elend;
+	a->index++;
+	b->pos = b->elend;
+	b->index++;
 	return 0;
 }
 
 
 /*
- * print indent
+ * report the current element of a list as only present in this file
+ * and move behind it
  */
 
-static void PrintIndent (void) {
-	int	i;
+static void DiffOnly (DiffCursor *c, const DiffPath *up) {
+	DiffPath	 path;
+
+	path.up    = up;
+	path.tag   = c->hdr.tag;
+	path.cl    = c->hdr.cl;
+	path.index = c->index;
+	DiffPrintPath (&path);
+	printf (": only in %s (at %ld, %ld bytes)\n", c->name, c->pos, c->elend - c->pos);
+	differences++;
 
-	if (do_prtoffset) 
-		printf("%08ld - ", asnFtell());
-	for (i = 0; i < indent; i++)
-		printf("   ");
+	c->pos = c->elend;
+	c->index++;
 }
-	
 
-/*****************************************************************************/
+
 /*
- * Convert tagnum to string
+ * Read the header of the current element of a list. Returns 1 if there
+ * is an element, 0 at the end of the list and -1 on errors.
  */
-static char *tagstrings[]= {  0,
-		  /*    1                      2                  3           */
-			"Boolean",	 			"Integer",			"Bitstring",
-		  /*    4          	           5                  6           */
-			"Octetstring",			"Null",				"Objectidentifier",
-		  /*    7                      8                  9           */
-			"Objectdescriptor",		"External",			"Real",
-		  /*   10                     11                 12           */
-			"Enumerated",			"<reserved>",		"<reserved>",
-		  /*   13                     14                 15           */
-			"<reserved>",			"<reserved>",		"<reserved>",
-		  /*   16                     17                 18           */
-			"Sequence",				"Set",				"NumString",
-		  /*   19              		  20                 21           */
-			"Printable String",		"Teletex",			"Videotex",
-		  /*   22            	  	  23                 24           */
-			"IA5 String",			"UCTtime",			"Time",
-		  /*   25           		  26                 27           */
-			"Graphic String",		"Visible String",	"General String",
-				0
-			};
 
-static char *Tag2String (long tag, int cl) {
-	static char	buffer[20];
-
-	switch (cl) {
-		case asnPRIVATE:
-			sprintf (buffer, "P[%ld]", tag);
-			return buffer;
-		case asnAPPLICATION:
-			sprintf (buffer, "A[%ld]", tag);
-			return buffer;
-		case asnCONTEXT:
-			sprintf (buffer, "C[%ld]", tag);
-			return buffer;
-		case asnUNIVERSAL:
-			return (tag<0 || tag>27) ? " " : tagstrings[(int)tag];
-		default:
-			return "<=>";
-	} /* switch */
-	/* never reached */
+static int DiffRead (DiffCursor *c) {
+	long	 limit;
+	int		 rc;
+
+	if (c->top)			/* skip padding between top-level elements */
+		while (c->pos + 1 < c->length && c->data[c->pos] == 0 && c->data[c->pos + 1] == 0)
+			c->pos += 2;
+
+	limit = (c->end != -1) ? c->end : c->length;
+	if (c->pos >= limit) {
+		if (c->end != -1)
+			return 0;
+		return DiffError (c, "missing end-of-contents");
+	}
+	if ((rc = berReadHeader (c->data + c->pos, limit - c->pos, &c->hdr)) < 0) {
+		if (c->top && rc == berTRUNCATED)
+			return 0;	/* no complete element at the end of the file */
+		return DiffError (c, "bad header");
+	}
+	if (berIsEOC (&c->hdr) && c->end == -1)
+		return 0;
+	if (c->hdr.length == -1) {
+		if (c->hdr.pc == berPRIMITIVE)
+			return DiffError (c, "indefinite length of a primitive element");
+		c->elend = -1;
+	} else {
+		if (c->hdr.length > limit - c->pos - c->hdr.hdrlen)
+			return DiffError (c, "length beyond the end of the enclosing element");
+		c->elend = c->pos + c->hdr.hdrlen + c->hdr.length;
+	}
+	return 1;
 }
 
 
 /*
- * Convert class to string
+ * find the end of the current element if it has an indefinite length
  */
 
-static char *Class2String (int cl) {
-	switch (cl) {
-		case	asnUNIVERSAL:		return "UNIV";
-		case	asnAPPLICATION:		return "APPL";
-		case	asnCONTEXT:			return "CONT";
-		case	asnPRIVATE:			return "PRIV";
+static int DiffSkip (DiffCursor *c) {
+	if (c->elend != -1)
+		return 0;
+	if ((c->elend = ecFindEnd (c->cache, c->data, c->length, c->pos)) < 0) {
+		c->elend = -1;
+		return DiffError (c, "element without end");
 	}
-	/* Hopefully never reached */
-	return "unknown class";
+	return 0;
 }
 
 
 /*
- * Convert pc to string
+ * report an encoding error, the diff can't go on
+ */
+
+static int DiffError (DiffCursor *c, const char *msg) {
+	fprintf (stderr, "asn1dump: %s: %s at position %ld\n", c->name, msg, c->pos);
+	return -1;
+}
+
+
+/*
+ * print the path of an element, "record n: tag/tag#i/..."
  */
 
-static char *Pc2String (int pc) {
-	switch (pc) {
-		case	asnPRIMITIVE:		return "PRIM";
-		case	asnCONSTRUCTED:		return "CONST";
+static void DiffPrintPath (const DiffPath *path) {
+	if (path->up == NULL)
+		printf ("record %ld: %s", path->index, Tag2String (path->tag, path->cl));
+	else {
+		DiffPrintPath (path->up);
+		printf ("/%s#%ld", Tag2String (path->tag, path->cl), path->index);
 	}
-	/* Hopefully never reached */
-	return "unknown pc";
+}
+
+
+/*****************************************************************************/
+/*
+ * Convert tagnum to string
+ */
+
+static const char *Tag2String (long tag, int cl) {
+	static THREAD_LOCAL char	buffer[24];
+
+	if (cl == berUNIVERSAL)
+		return (tag<0 || tag>MAXTAGSTRING) ? " " : tagstrings[tag];
+	if (cl < berAPPLICATION || cl > berPRIVATE)
+		return "<=>";
+	if (tag >= 0 && tag <= MAXTAGNAME)
+		return tagnames[cl - berAPPLICATION][tag];
+	sprintf (buffer, "%c[%ld]", "UACP"[cl], tag);
+	return buffer;
+}
+
+
+/*
+ * Convert pc to string
+ */
+
+static const char *Pc2String (int pc) {
+	static const char *const names[]= { "PRIM", "CONST" };
+
+	return (pc == berPRIMITIVE || pc == berCONSTRUCTED) ? names[pc] : "unknown pc";
 }
 
 /*****************************************************************************
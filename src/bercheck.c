@@ -0,0 +1,321 @@
+/*
+ *	bercheck.c
+ *
+ *	Check the encoding rules of the elements in a TLV tree: what BER
+ *	requires of every encoding, and optionally the stricter rules of DER.
+ */
+
+# include	<stdio.h>
+# include	<string.h>
+# include	"bercheck.h"
+
+
+static long	 CheckHeader (TlvTree *, long, int, CheckReport, void *);
+static long	 CheckValue (TlvTree *, long, int, CheckReport, void *);
+static long	 CheckSet (TlvTree *, long, CheckReport, void *);
+static int	 CheckTime (const byte *, long, int);
+static int	 CompareEncodings (const byte *, long, const byte *, long);
+
+
+/*
+ *	Types which must be primitive in every encoding (1) and in DER (2),
+ *	and types which must be constructed (3), by universal tag
+ */
+static const byte	 form[31]= {
+	0,	1,	1,	2,	2,	1,	1,	2,			/* EOC .. ObjectDescriptor	*/
+	3,	1,	1,	3,	2,	1,	0,	0,			/* EXTERNAL .. <reserved>	*/
+	3,	3,	2,	2,	2,	2,	2,	2,			/* SEQUENCE .. UTCTime		*/
+	2,	2,	2,	2,	2,	3,	2			/* GeneralizedTime .. BMP	*/
+};
+
+
+/*:>* bercheck.c ************************************************************
+
+Name
+	chkTree
+
+Info
+	Check the encoding of all elements in a TLV tree
+
+Syntax
+	long chkTree (TlvTree *tree, int der, CheckReport report, void *arg);
+
+Include
+	bercheck.h
+
+Description
+	`chkTree()` checks every node of `tree` against the rules of X.690
+	which can be verified without knowing the ASN.1 type definitions:$
+	The identifier octets must use the shortest form, BOOLEAN, INTEGER,
+	ENUMERATED, NULL, OBJECT IDENTIFIER and REAL must be primitive and
+	SEQUENCE and SET constructed, INTEGER values must not have redundant
+	leading octets, BOOLEAN must be one octet and NULL empty, object
+	identifiers must be complete and the unused bits of a BIT STRING must
+	be between 0 and 7.$
+	If `der` is set the rules of DER are checked in addition: only
+	definite lengths in the shortest form, primitive encodings of strings
+	and times, TRUE encoded as FF, zero unused bits, times in UTC with
+	'Z' and without trailing zeros in the fraction, and the components of
+	a SET sorted by tag, components with the same tag (SET OF) by their
+	encodings.$
+	For every violation `report` is called with the offset of the
+	element, the violated rule `chkXXX` and `arg`.
+
+Return value
+	The function returns the number of violations found.
+
+Example
+	% static void Report (long pos, int rule, void *arg) {
+	%	printf ("at position %ld: %s\n", pos, chkMessage (rule));
+	% }
+	%
+	% if (chkTree (&tree, 1, Report, NULL) > 0)
+	%	exit (1);
+
+See also
+	chkMessage, tlvParse
+
+**************************************************************************<:*/
+
+long chkTree (TlvTree *t, int der, CheckReport report, void *arg) {
+	long	 n,
+			 count;
+
+	count= 0;
+	for (n= 0; n < t->count; n++) {
+		count+= CheckHeader (t, n, der, report, arg);
+		if (tlvClass (t, n) == berUNIVERSAL)
+			count+= CheckValue (t, n, der, report, arg);
+	}
+	return count;
+}
+
+
+/*:>* bercheck.c ************************************************************
+
+Name
+	chkMessage
+
+Info
+	Describe a rule of chkTree()
+
+Syntax
+	const char *chkMessage (int rule);
+
+Include
+	bercheck.h
+
+Return value
+	The function returns a text describing the violation of `rule`.
+
+See also
+	chkTree
+
+**************************************************************************<:*/
+
+const char *chkMessage (int rule) {
+	switch (rule) {
+		case chkTAGFORM:		return "tag number not in the shortest form";
+		case chkLENGTHFORM:		return "length not in the shortest form";
+		case chkINDEFINITE:		return "indefinite length";
+		case chkCONSTRUCTED:	return "constructed encoding of a primitive type";
+		case chkPRIMITIVE:		return "primitive encoding of a constructed type";
+		case chkBOOLEAN:		return "BOOLEAN not encoded as 00 or FF";
+		case chkINTEGER:		return "INTEGER empty or with redundant leading octets";
+		case chkNULL:			return "NULL with content";
+		case chkOID:			return "malformed OBJECT IDENTIFIER";
+		case chkBITSTRING:		return "bad unused bits of a BIT STRING";
+		case chkTIME:			return "time not in DER form";
+		case chkSETORDER:		return "components of a SET not in canonical order";
+		case chkPADDING:		return "end-of-contents between elements";
+		case chkTRUNCATED:		return "incomplete element at end of data";
+	}
+	return "unknown rule";
+}
+
+
+/*
+ * check the identifier and length octets
+ */
+
+static long CheckHeader (TlvTree *t, long n, int der, CheckReport report, void *arg) {
+	const byte	*hdr;
+	long		 count,
+				 length;
+	int			 lenoctets;
+
+	hdr= t->data + t->offset[n];
+	count= 0;
+
+	if (t->taglen[n] > 1 && (t->tag[n] < 0x1f || hdr[1] == 0x80)) {
+		report (t->offset[n], chkTAGFORM, arg);
+		count++;
+	}
+
+	if (der && t->length[n] == -1) {
+		report (t->offset[n], chkINDEFINITE, arg);
+		count++;
+	} else if (der) {
+		lenoctets= 1;
+		if (t->length[n] > 0x7f)
+			for (length= t->length[n]; length > 0; length>>= 8)
+				lenoctets++;
+		if (t->hdrlen[n] - t->taglen[n] != lenoctets) {
+			report (t->offset[n], chkLENGTHFORM, arg);
+			count++;
+		}
+	}
+	return count;
+}
+
+
+/*
+ * check a universal element
+ */
+
+static long CheckValue (TlvTree *t, long n, int der, CheckReport report, void *arg) {
+	const byte	*content;
+	long		 length,
+				 tag,
+				 i;
+	int			 rule;
+
+	tag= t->tag[n];
+	content= tlvContent (t, n);
+	length= tlvContentLength (t, n);
+
+	if (tag <= 30 && form[tag] != 0) {
+		if (tlvPc (t, n) == berCONSTRUCTED && (form[tag] == 1 || (der && form[tag] == 2))) {
+			report (t->offset[n], chkCONSTRUCTED, arg);
+			return 1;
+		}
+		if (tlvPc (t, n) == berPRIMITIVE && form[tag] == 3) {
+			report (t->offset[n], chkPRIMITIVE, arg);
+			return 1;
+		}
+	}
+	if (tlvPc (t, n) == berCONSTRUCTED)
+		return (der && tag == berSET) ? CheckSet (t, n, report, arg) : 0;
+
+	rule= 0;
+	switch (tag) {
+		case berBOOLEAN:
+			if (length != 1 || (der && content[0] != 0x00 && content[0] != 0xff))
+				rule= chkBOOLEAN;
+			break;
+
+		case berINTEGER:
+		case berENUMERATED:
+			if (length == 0 || (length > 1 &&
+				((content[0] == 0x00 && !(content[1] & 0x80)) ||
+				 (content[0] == 0xff && (content[1] & 0x80)))))
+				rule= chkINTEGER;
+			break;
+
+		case berNULL:
+			if (length != 0)
+				rule= chkNULL;
+			break;
+
+		case berOBJECTID:
+		case 13:								/* RELATIVE-OID */
+			if (length == 0 || (content[length - 1] & 0x80))
+				rule= chkOID;
+			for (i= 0; i < length && rule == 0; i++)
+				if (content[i] == 0x80 && (i == 0 || !(content[i - 1] & 0x80)))
+					rule= chkOID;				/* leading 0x80 of a subidentifier */
+			break;
+
+		case berBITSTRING:
+			if (length == 0 || content[0] > 7 || (length == 1 && content[0] != 0) ||
+				(der && length > 1 && (content[length - 1] & ((1 << content[0]) - 1))))
+				rule= chkBITSTRING;
+			break;
+
+		case berUTCTIME:
+		case berGENERALIZEDTIME:
+			if (der && CheckTime (content, length, tag == berGENERALIZEDTIME) == -1)
+				rule= chkTIME;
+			break;
+	}
+	if (rule == 0)
+		return 0;
+	report (t->offset[n], rule, arg);
+	return 1;
+}
+
+
+/*
+ * check the order of the components of a SET
+ */
+
+static long CheckSet (TlvTree *t, long n, CheckReport report, void *arg) {
+	long	 prev,
+			 child;
+	int		 cl,
+			 pcl;
+
+	prev= t->child[n];
+	if (prev == -1)
+		return 0;
+	for (child= t->next[prev]; child != -1; prev= child, child= t->next[child]) {
+		cl= tlvClass (t, child);
+		pcl= tlvClass (t, prev);
+		if (cl > pcl || (cl == pcl && t->tag[child] > t->tag[prev]))
+			continue;
+		if (cl == pcl && t->tag[child] == t->tag[prev] &&
+			CompareEncodings (t->data + t->offset[prev], t->end[prev] - t->offset[prev],
+							  t->data + t->offset[child], t->end[child] - t->offset[child]) <= 0)
+			continue;
+		report (t->offset[child], chkSETORDER, arg);
+		return 1;
+	}
+	return 0;
+}
+
+
+/*
+ * Compare two encodings as in X.690 11.6, the shorter one padded with
+ * zero octets. Returns <0, 0 or >0 like memcmp().
+ */
+
+static int CompareEncodings (const byte *a, long alen, const byte *b, long blen) {
+	long	 i;
+	int		 rc;
+
+	if ((rc= memcmp (a, b, (size_t)(alen < blen ? alen : blen))) != 0)
+		return rc;
+	for (i= blen; i < alen; i++)
+		if (a[i] != 0)
+			return 1;
+	for (i= alen; i < blen; i++)
+		if (b[i] != 0)
+			return -1;
+	return 0;
+}
+
+
+/*
+ * check the DER form of UTCTime (YYMMDDhhmmssZ) and GeneralizedTime
+ * (YYYYMMDDhhmmss[.f*]Z without trailing zeros in the fraction)
+ */
+
+static int CheckTime (const byte *content, long length, int generalized) {
+	long	 digits,
+			 i;
+
+	digits= generalized ? 14 : 12;
+	if (length < digits + 1 || content[length - 1] != 'Z')
+		return -1;
+	for (i= 0; i < digits; i++)
+		if (content[i] < '0' || content[i] > '9')
+			return -1;
+	if (length == digits + 1)
+		return 0;
+	if (!generalized || content[digits] != '.' || length == digits + 2 || content[length - 2] == '0')
+		return -1;
+	for (i= digits + 1; i < length - 1; i++)
+		if (content[i] < '0' || content[i] > '9')
+			return -1;
+	return 0;
+}
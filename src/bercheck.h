@@ -0,0 +1,34 @@
+/*
+ *	bercheck.h
+ *
+ *	Includefile for bercheck.c
+ */
+
+#ifndef __BERCHECK_H__
+#define __BERCHECK_H__
+
+#include "vlARGS.h"
+#include "tlvtree.h"
+
+/* Rules, see chkMessage() */
+# define	chkTAGFORM			1		/* tag number not in shortest form		*/
+# define	chkLENGTHFORM		2		/* length not in shortest form (DER)	*/
+# define	chkINDEFINITE		3		/* indefinite length (DER)				*/
+# define	chkCONSTRUCTED		4		/* constructed, must be primitive		*/
+# define	chkPRIMITIVE		5		/* primitive, must be constructed		*/
+# define	chkBOOLEAN			6		/* BOOLEAN not one octet, TRUE not FF	*/
+# define	chkINTEGER			7		/* INTEGER empty or not minimal			*/
+# define	chkNULL				8		/* NULL with content					*/
+# define	chkOID				9		/* malformed OBJECT IDENTIFIER			*/
+# define	chkBITSTRING		10		/* bad unused bits of a BIT STRING		*/
+# define	chkTIME				11		/* time not in DER form					*/
+# define	chkSETORDER			12		/* SET components not sorted (DER)		*/
+# define	chkPADDING			13		/* end-of-contents between elements		*/
+# define	chkTRUNCATED		14		/* incomplete element at end of data	*/
+
+typedef void	(*CheckReport) (long, int, void *);
+
+EXTERN long			 chkTree (TlvTree *, int, CheckReport, void *);
+EXTERN const char	*chkMessage (int);
+
+#endif
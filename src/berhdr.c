@@ -0,0 +1,86 @@
+/*:>* berhdr.c **************************************************************
+
+Name
+	berReadHeader
+
+Info
+	Decode the tag and length octets of a BER element in memory
+
+Syntax
+	int berReadHeader (const byte *data, long avail, BerHeader *hdr);
+
+Include
+	berhdr.h
+
+Description
+	`berReadHeader()` decodes the identifier and length octets at `data`
+	into `hdr`. At most `avail` bytes are looked at. Only the header is
+	decoded, the content of the element is never touched, so a whole file
+	can be walked by adding `hdr->hdrlen` and `hdr->length` to the position.$
+	An indefinite length is returned as -1 in `hdr->length`.
+
+Return value
+	The function returns the number of header octets, or `berTRUNCATED` if
+	the header doesn't fit into `avail` bytes, or `berBADLENGTH` if the
+	length field is reserved or too large for a `long`.
+
+Example
+	% BerHeader	hdr;
+	%
+	% if (berReadHeader (map + pos, flength - pos, &hdr) > 0)
+	%	pos+= hdr.hdrlen + hdr.length;
+
+**************************************************************************<:*/
+
+# include	<stdio.h>
+# include	"berhdr.h"
+
+int berReadHeader (const byte *data, long avail, BerHeader *hdr) {
+	long	 pos,
+			 length;
+	int		 n;
+
+	if (avail < 2)
+		return berTRUNCATED;
+
+	hdr->cl= data[0] >> 6;
+	hdr->pc= (data[0] >> 5) & 1;
+	pos= 1;
+
+	if ((data[0] & 0x1f) != 0x1f)
+		hdr->tag= data[0] & 0x1f;
+	else {								/* high tag number form */
+		hdr->tag= 0;
+		do {
+			if (pos >= avail)
+				return berTRUNCATED;
+			if (pos > (long)sizeof(long))
+				return berBADLENGTH;
+			hdr->tag= (hdr->tag << 7) | (data[pos] & 0x7f);
+		} while (data[pos++] & 0x80);
+	}
+	hdr->taglen= (int)pos;
+
+	if (pos >= avail)
+		return berTRUNCATED;
+	if (data[pos] < 0x80)
+		length= data[pos++];
+	else if (data[pos] == 0x80) {
+		length= -1;
+		pos++;
+	} else {
+		n= data[pos++] & 0x7f;
+		if (n == 0x7f || n > (int)sizeof(long))
+			return berBADLENGTH;
+		if (pos + n > avail)
+			return berTRUNCATED;
+		for (length= 0; n > 0; n--) {
+			if (length >> ((sizeof(long) - 1) * 8 - 1))
+				return berBADLENGTH;		/* would overflow */
+			length= (length << 8) | data[pos++];
+		}
+	}
+	hdr->hdrlen= (int)pos;
+	hdr->length= length;
+	return hdr->hdrlen;
+}
@@ -0,0 +1,72 @@
+/*
+ *	berhdr.h
+ *
+ *	Includefile for berhdr.c
+ */
+
+#ifndef __BERHDR_H__
+#define __BERHDR_H__
+
+#include "vlARGS.h"
+
+typedef unsigned char	byte;
+
+/* Tag classes */
+# define	berUNIVERSAL		0
+# define	berAPPLICATION		1
+# define	berCONTEXT			2
+# define	berPRIVATE			3
+
+/* Primitive / constructed */
+# define	berPRIMITIVE		0
+# define	berCONSTRUCTED		1
+
+/* Universal tag numbers */
+# define	berENDCONTENTS		0
+# define	berBOOLEAN			1
+# define	berINTEGER			2
+# define	berBITSTRING		3
+# define	berOCTETSTRING		4
+# define	berNULL				5
+# define	berOBJECTID			6
+# define	berOBJDESCRIPTOR	7
+# define	berEXTERNAL			8
+# define	berREAL				9
+# define	berENUMERATED		10
+# define	berUTF8STRING		12
+# define	berSEQUENCE			16
+# define	berSET				17
+# define	berNUMERICSTRING	18
+# define	berPRINTABLESTRING	19
+# define	berTELETEXSTRING	20
+# define	berVIDEOTEXSTRING	21
+# define	berIA5STRING		22
+# define	berUTCTIME			23
+# define	berGENERALIZEDTIME	24
+# define	berGRAPHICSTRING	25
+# define	berVISIBLESTRING	26
+# define	berGENERALSTRING	27
+# define	berUNIVERSALSTRING	28
+# define	berBMPSTRING		30
+
+/* Return values of berReadHeader() */
+# define	berTRUNCATED		-1		/* header runs past the end of the data	*/
+# define	berBADLENGTH		-2		/* length field can't be represented	*/
+
+/*
+ *	A decoded tag/length header
+ */
+typedef struct {
+	int		 cl;			/* class									*/
+	int		 pc;			/* primitive / constructed					*/
+	long	 tag;			/* tag number								*/
+	int		 taglen;		/* number of identifier octets				*/
+	int		 hdrlen;		/* number of identifier and length octets	*/
+	long	 length;		/* content length, -1 if indefinite			*/
+} BerHeader;
+
+# define	berIsEOC(h)		((h)->tag == berENDCONTENTS && (h)->cl == berUNIVERSAL && (h)->length == 0)
+
+EXTERN int	 berReadHeader (const byte *, long, BerHeader *);
+
+#endif
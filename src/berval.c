@@ -0,0 +1,681 @@
+/*
+ *	berval.c
+ *
+ *	Decode the content octets of primitive BER values. All functions
+ *	work on the content in memory and don't allocate anything.
+ */
+
+# include	<stdio.h>
+# include	<stdlib.h>
+# include	<string.h>
+# include	<math.h>
+# include	"berval.h"
+
+
+/*:>* berval.c **************************************************************
+
+Name
+	berGetBoolean
+
+Info
+	Decode a BOOLEAN value
+
+Syntax
+	int berGetBoolean (const byte *content, long length, int *value);
+
+Include
+	berval.h
+
+Description
+	`berGetBoolean()` stores 1 in `value` if the content octet is not zero
+	and 0 otherwise.
+
+Return value
+	The function returns 0 on success or -1 if `length` isn't 1.
+
+See also
+	berGetInteger
+
+**************************************************************************<:*/
+
+int berGetBoolean (const byte *content, long length, int *value) {
+	if (length != 1)
+		return -1;
+	*value= (content[0] != 0);
+	return 0;
+}
+
+
+/*:>* berval.c **************************************************************
+
+Name
+	berGetInteger
+
+Info
+	Decode an INTEGER or ENUMERATED value
+
+Syntax
+	int berGetInteger (const byte *content, long length, long *value);
+
+Include
+	berval.h
+
+Description
+	`berGetInteger()` decodes the two's complement content of an INTEGER
+	or ENUMERATED value into `value`.
+
+Return value
+	The function returns 0 on success or -1 if the value is empty or
+	doesn't fit into a `long`.
+
+See also
+	berGetBoolean
+
+**************************************************************************<:*/
+
+int berGetInteger (const byte *content, long length, long *value) {
+	unsigned long	 v;
+	long			 i;
+
+	if (length < 1 || length > (long)sizeof(long))
+		return -1;
+	v= (content[0] & 0x80) ? ~0UL : 0UL;
+	for (i= 0; i < length; i++)
+		v= (v << 8) | content[i];
+	*value= (long)v;
+	return 0;
+}
+
+
+/*:>* berval.c **************************************************************
+
+Name
+	berGetBigInteger
+
+Info
+	Convert an INTEGER of any length into a decimal or hex string
+
+Syntax
+	long berGetBigInteger (const byte *content, long length, int hex,
+						   char *buffer, long size, unsigned long *work);
+
+Include
+	berval.h
+
+Description
+	`berGetBigInteger()` converts the two's complement content of an
+	INTEGER or ENUMERATED value into a decimal string or, if `hex` is
+	set, into a hex string with the prefix "0x". Negative values get a
+	leading '-' in both cases. The string is written into `buffer`, which
+	can hold `size` characters. A `size` of `3 * length + 4` is always
+	sufficient.$
+	`work` must point to `(length + 3) / 4` words of scratch space. The
+	decimal conversion takes 18 digits at a time from the magnitude, so
+	its cost grows with the square of `length` divided by 18.
+
+Return value
+	The function returns the length of the string or -1 if the value is
+	empty or `buffer` is too small.
+
+See also
+	berGetInteger
+
+**************************************************************************<:*/
+
+/*
+ * divide the nwords 32 bit words in w by 10^18 in one pass: two divisions
+ * by 10^9, the second takes each quotient word of the first as it comes.
+ * Returns the remainder.
+ */
+static unsigned long long DivChunk (unsigned long *w, long nwords) {
+	unsigned long long	 cur;
+	unsigned long		 lo,
+						 hi,
+						 q;
+	long				 i;
+
+	for (lo= hi= 0, i= 0; i < nwords; i++) {
+		cur= ((unsigned long long)lo << 32) | w[i];
+		q= (unsigned long)(cur / 1000000000UL);
+		lo= (unsigned long)(cur % 1000000000UL);
+		cur= ((unsigned long long)hi << 32) | q;
+		w[i]= (unsigned long)(cur / 1000000000UL);
+		hi= (unsigned long)(cur % 1000000000UL);
+	}
+	return lo + (unsigned long long)hi * 1000000000UL;
+}
+
+long berGetBigInteger (const byte *content, long length, int hex, char *buffer, long size, unsigned long *work) {
+	static const char	 hexdigits[]= "0123456789ABCDEF";
+	unsigned long long	 chunk;
+	unsigned long		 carry;
+	long				 nwords,
+						 first,
+						 i,
+						 n;
+	char				*p;
+	int					 neg,
+						 digits;
+	byte				 b;
+
+	if (length < 1 || size < 3 * length + 4)
+		return -1;
+
+	/* magnitude as big-endian 32 bit words */
+	neg= (content[0] & 0x80) != 0;
+	nwords= (length + 3) / 4;
+	for (i= 0; i < nwords; i++)
+		work[i]= 0;
+	carry= neg;
+	for (i= length - 1; i >= 0; i--) {
+		b= neg ? (byte)~content[i] : content[i];
+		carry+= b;
+		n= length - 1 - i;				/* byte number from the right */
+		work[nwords - 1 - n / 4]|= (carry & 0xff) << (8 * (n % 4));
+		carry>>= 8;
+	}
+	for (first= 0; first < nwords && work[first] == 0; first++)
+		/* empty */ ;
+
+	p= buffer + size;					/* digits are written backwards */
+	if (first == nwords)
+		*--p= '0';
+	else if (hex) {
+		for (i= nwords - 1; i >= first; i--)
+			for (n= 0; n < 8 && (i > first || (work[i] >> (4 * n)) != 0); n++)
+				*--p= hexdigits[(work[i] >> (4 * n)) & 0xf];
+		*--p= 'x';
+		*--p= '0';
+	} else
+		while (first < nwords) {
+			chunk= DivChunk (work + first, nwords - first);
+			while (first < nwords && work[first] == 0)
+				first++;
+			for (digits= 0; digits < 18 && (chunk != 0 || first < nwords); digits++) {
+				*--p= (char)('0' + chunk % 10);
+				chunk/= 10;
+			}
+		}
+	if (neg)
+		*--p= '-';
+
+	n= (long)(buffer + size - p);
+	memmove (buffer, p, (size_t)n);
+	return n;
+}
+
+
+/*:>* berval.c **************************************************************
+
+Name
+	berGetOid
+
+Info
+	Decode an OBJECT IDENTIFIER into its dotted form
+
+Syntax
+	int berGetOid (const byte *content, long length, char *buffer, int size);
+
+Include
+	berval.h
+
+Description
+	`berGetOid()` writes the dotted form of the OBJECT IDENTIFIER in
+	`content` into `buffer`, which can hold `size` characters. Arcs too
+	big for an `unsigned long`, like the UUIDs under 2.25, are converted
+	digit by digit.
+
+Return value
+	The function returns the length of the string or -1 if the encoding
+	is invalid or the string doesn't fit into `buffer`.
+
+Example
+	% char	oid[256];
+	%
+	% if (berGetOid (content, length, oid, sizeof(oid)) != -1)
+	%	printf ("%s\n", oid);
+
+**************************************************************************<:*/
+
+/*
+ * write the arc in the count 7 bit groups at p less sub in decimal into
+ * buffer, return the number of digits or -1 if they don't fit into size
+ */
+static int BigArc (const byte *p, long count, int sub, char *buffer, int size) {
+	long	 i;
+	int		 n,
+			 k,
+			 d;
+	char	 c;
+
+	/* the digits as values, lowest first: multiply by 128, add the group */
+	for (n= 0, i= 0; i < count; i++) {
+		d= p[i] & 0x7f;
+		for (k= 0; k < n; k++) {
+			d+= buffer[k] * 128;
+			buffer[k]= (char)(d % 10);
+			d/= 10;
+		}
+		for (; d != 0; d/= 10) {
+			if (n >= size)
+				return -1;
+			buffer[n++]= (char)(d % 10);
+		}
+	}
+	for (k= 0, d= sub; d != 0; k++) {	/* the arc is far bigger than sub */
+		c= (char)(buffer[k] - d % 10);
+		d/= 10;
+		if (c < 0) {
+			c+= 10;
+			d++;
+		}
+		buffer[k]= c;
+	}
+	while (n > 1 && buffer[n - 1] == 0)
+		n--;
+	for (k= 0; k < n / 2; k++) {
+		c= buffer[k];
+		buffer[k]= buffer[n - 1 - k];
+		buffer[n - 1 - k]= c;
+	}
+	for (k= 0; k < n; k++)
+		buffer[k]+= '0';
+	return n;
+}
+
+int berGetOid (const byte *content, long length, char *buffer, int size) {
+	unsigned long	 v,
+					 x;
+	long			 i,
+					 start;
+	int				 n,
+					 k,
+					 first,
+					 big;
+
+	if (length < 1 || (content[length - 1] & 0x80))
+		return -1;
+
+	n= 0;
+	v= 0;
+	first= 1;
+	big= 0;
+	for (start= i= 0; i < length; i++) {
+		if (v >> (8 * sizeof(unsigned long) - 7) != 0)
+			big= 1;						/* the next group doesn't fit */
+		v= (v << 7) | (content[i] & 0x7f);
+		if (content[i] & 0x80)
+			continue;
+		if (size - n < 2 * (int)sizeof(unsigned long) * 3 + 3)	/* room for two numbers */
+			return -1;
+		if (big) {
+			n+= sprintf (buffer + n, first ? "2." : ".");
+			if ((k= BigArc (content + start, i + 1 - start, first ? 80 : 0, buffer + n, size - n - 1)) == -1)
+				return -1;
+			n+= k;
+			buffer[n]= '\0';
+			first= 0;
+		} else if (first) {
+			x= (v < 80) ? v / 40 : 2;
+			n+= sprintf (buffer + n, "%lu.%lu", x, v - 40 * x);
+			first= 0;
+		} else
+			n+= sprintf (buffer + n, ".%lu", v);
+		v= 0;
+		big= 0;
+		start= i + 1;
+	}
+	return n;
+}
+
+
+/*:>* berval.c **************************************************************
+
+Name
+	berGetBitString
+
+Info
+	Check a BIT STRING value
+
+Syntax
+	long berGetBitString (const byte *content, long length);
+
+Include
+	berval.h
+
+Description
+	`berGetBitString()` checks the initial octet of a primitive BIT STRING,
+	which holds the number of unused bits in the last content octet. The
+	bits themselves start at `content + 1`.
+
+Return value
+	The function returns the number of bits in the string or -1 if the
+	encoding is invalid.
+
+**************************************************************************<:*/
+
+long berGetBitString (const byte *content, long length) {
+	if (length < 1 || content[0] > 7 || (length == 1 && content[0] != 0))
+		return -1;
+	return (length - 1) * 8 - content[0];
+}
+
+
+/*:>* berval.c **************************************************************
+
+Name
+	berGetTime
+
+Info
+	Decode a UTCTime or GeneralizedTime value into ISO-8601 form
+
+Syntax
+	int berGetTime (const byte *content, long length, int generalized,
+					char *buffer, int size);
+
+Include
+	berval.h
+
+Description
+	`berGetTime()` converts the UTCTime (`generalized` is 0) or the
+	GeneralizedTime (`generalized` is not 0) in `content` into its ISO-8601
+	form, for example "2016-04-16T10:20:30.5Z", and writes it into `buffer`,
+	which can hold `size` characters. Two-digit years of a UTCTime below 50
+	are in the 21st century. Missing minutes or seconds are left out, a
+	local time (without "Z" or a time difference) gets no suffix.
+
+Return value
+	The function returns the length of the string or -1 if the value is
+	malformed or doesn't fit into `buffer`.
+
+**************************************************************************<:*/
+
+# define	DIGITS2(p)	(((p)[0] - '0') * 10 + (p)[1] - '0')
+
+static int IsDigits (const byte *p, long n) {
+	for (; n > 0; n--, p++)
+		if (*p < '0' || *p > '9')
+			return 0;
+	return 1;
+}
+
+int berGetTime (const byte *content, long length, int generalized, char *buffer, int size) {
+	const byte	*p,
+				*end;
+	char		*b;
+	int			 year,
+				 month,
+				 day,
+				 hour;
+
+	p= content;
+	end= content + length;
+
+	/* date and hour */
+	if (generalized) {
+		if (length < 10 || !IsDigits (p, 10))
+			return -1;
+		year= DIGITS2(p) * 100 + DIGITS2(p + 2);
+		p+= 4;
+	} else {
+		if (length < 8 || !IsDigits (p, 8))
+			return -1;
+		year= DIGITS2(p);
+		year+= (year < 50) ? 2000 : 1900;
+		p+= 2;
+	}
+	month= DIGITS2(p);
+	day= DIGITS2(p + 2);
+	hour= DIGITS2(p + 4);
+	p+= 6;
+	if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 24)
+		return -1;
+
+	/* a value of at most 32 characters gives at most 43 characters */
+	if (size < 48 || length > 32)
+		return -1;
+	b= buffer + sprintf (buffer, "%04d-%02d-%02dT%02d", year, month, day, hour);
+
+	/* minutes and seconds, mandatory for UTCTime */
+	if (end - p >= 2 && IsDigits (p, 2)) {
+		if (DIGITS2(p) > 59)
+			return -1;
+		b+= sprintf (b, ":%02d", DIGITS2(p));
+		p+= 2;
+		if (end - p >= 2 && IsDigits (p, 2)) {
+			if (DIGITS2(p) > 60)		/* leap second */
+				return -1;
+			b+= sprintf (b, ":%02d", DIGITS2(p));
+			p+= 2;
+		}
+	} else if (!generalized)
+		return -1;
+
+	/* fraction, GeneralizedTime only */
+	if (generalized && p < end && (*p == '.' || *p == ',')) {
+		*b++= '.';
+		for (p++; p < end && IsDigits (p, 1); )
+			*b++= (char)*p++;
+		if (b[-1] == '.')
+			return -1;
+	}
+
+	/* time zone */
+	if (p < end && *p == 'Z') {
+		*b++= 'Z';
+		p++;
+	} else if (p < end && (*p == '+' || *p == '-')) {
+		if (end - p < 5 || !IsDigits (p + 1, 4) || DIGITS2(p + 1) > 23 || DIGITS2(p + 3) > 59)
+			return -1;
+		b+= sprintf (b, "%c%02d:%02d", *p, DIGITS2(p + 1), DIGITS2(p + 3));
+		p+= 5;
+	} else if (!generalized)
+		return -1;
+
+	if (p != end)
+		return -1;
+	*b= '\0';
+	return (int)(b - buffer);
+}
+
+
+/*:>* berval.c **************************************************************
+
+Name
+	berGetReal
+
+Info
+	Decode a REAL value
+
+Syntax
+	int berGetReal (const byte *content, long length, double *value);
+
+Include
+	berval.h
+
+Description
+	`berGetReal()` decodes the binary, decimal (ISO 6093) or special
+	(infinity, not-a-number, minus zero) encoding of a REAL value into
+	`value`. Mantissas with more bits than a `double` can hold lose
+	precision.
+
+Return value
+	The function returns 0 on success or -1 if the encoding is invalid.
+
+**************************************************************************<:*/
+
+int berGetReal (const byte *content, long length, double *value) {
+	const byte	*p;
+	char		 buffer[64],
+				*e;
+	long		 exponent,
+				 elen,
+				 i;
+	double		 mantissa;
+	int			 base;
+
+	if (length == 0) {
+		*value= 0.0;
+		return 0;
+	}
+
+	switch (content[0] & 0xc0) {
+		case 0x40:							/* special real value */
+			if (length != 1)
+				return -1;
+			switch (content[0]) {
+				case 0x40:	*value= HUGE_VAL;			return 0;
+				case 0x41:	*value= -HUGE_VAL;			return 0;
+				case 0x42:	*value= HUGE_VAL - HUGE_VAL;	return 0;
+				case 0x43:	*value= -0.0;				return 0;
+			}
+			return -1;
+
+		case 0x00:							/* decimal encoding */
+			if (length - 1 >= (long)sizeof(buffer))
+				return -1;
+			for (i= 1; i < length; i++)
+				buffer[i - 1]= (content[i] == ',') ? '.' : (char)content[i];
+			buffer[length - 1]= '\0';
+			*value= strtod (buffer, &e);
+			return (e == buffer) ? -1 : 0;
+	}
+
+	/* binary encoding */
+	switch ((content[0] >> 4) & 3) {
+		case 0:		base= 1;	break;		/* log2 of the base */
+		case 1:		base= 3;	break;
+		case 2:		base= 4;	break;
+		default:	return -1;
+	}
+	p= content + 1;
+	if ((content[0] & 3) == 3) {
+		if (length < 2)
+			return -1;
+		elen= *p++;
+	} else
+		elen= (content[0] & 3) + 1;
+	if (elen < 1 || elen > (long)sizeof(long) || p + elen > content + length)
+		return -1;
+	exponent= (*p & 0x80) ? -1 : 0;
+	for (i= 0; i < elen; i++)
+		exponent= (long)(((unsigned long)exponent << 8) | *p++);
+	for (mantissa= 0.0; p < content + length; p++)
+		mantissa= mantissa * 256.0 + *p;
+
+	mantissa= ldexp (mantissa, (int)((content[0] >> 2) & 3));	/* scaling factor */
+	if (exponent > 100000 || exponent < -100000)
+		*value= (exponent > 0 && mantissa != 0.0) ? HUGE_VAL : 0.0;
+	else
+		*value= ldexp (mantissa, (int)exponent * base);
+	if (content[0] & 0x40)
+		*value= -*value;
+	return 0;
+}
+
+
+/*:>* berval.c **************************************************************
+
+Name
+	berGetUnicode
+
+Info
+	Convert a UTF8String, BMPString or UniversalString into UTF-8
+
+Syntax
+	long berGetUnicode (const byte *content, long length, int width,
+						char *buffer, long size);
+
+Include
+	berval.h
+
+Description
+	`berGetUnicode()` converts the characters in `content` into UTF-8 and
+	writes them into `buffer`, which can hold `size` bytes. `width` is the
+	number of octets per character: 1 for UTF8String (which is checked
+	for valid UTF-8), 2 for BMPString and 4 for UniversalString. A buffer
+	of `2 * length` bytes is always large enough.$
+	The string in `buffer` isn't terminated.
+
+Return value
+	The function returns the number of bytes written or -1 if the
+	content isn't valid or doesn't fit into `buffer`.
+
+**************************************************************************<:*/
+
+long berGetUnicode (const byte *content, long length, int width, char *buffer, long size) {
+	unsigned long	 c,
+					 min;
+	long			 i,
+					 n,
+					 k;
+	int				 more;
+
+	if (width != 1 && width != 2 && width != 4)
+		return -1;
+	if (length % width)
+		return -1;
+
+	for (i= 0, n= 0; i < length; ) {
+		if (width == 1) {				/* decode UTF-8 to check it */
+			c= content[i++];
+			if (c < 0x80) {
+				more= 0;
+				min= 0;
+			} else if (c >= 0xc2 && c <= 0xdf) {
+				more= 1;
+				min= 0x80;
+				c&= 0x1f;
+			} else if (c >= 0xe0 && c <= 0xef) {
+				more= 2;
+				min= 0x800;
+				c&= 0x0f;
+			} else if (c >= 0xf0 && c <= 0xf4) {
+				more= 3;
+				min= 0x10000;
+				c&= 0x07;
+			} else
+				return -1;
+			if (i + more > length)
+				return -1;
+			for (; more > 0; more--) {
+				if ((content[i] & 0xc0) != 0x80)
+					return -1;
+				c= (c << 6) | (content[i++] & 0x3f);
+			}
+			if (c < min)				/* overlong encoding */
+				return -1;
+		} else {
+			for (c= 0, k= 0; k < width; k++)
+				c= (c << 8) | content[i++];
+		}
+		if (c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff))
+			return -1;
+
+		/* encode as UTF-8 */
+		k= (c < 0x80) ? 1 : (c < 0x800) ? 2 : (c < 0x10000) ? 3 : 4;
+		if (n + k > size)
+			return -1;
+		switch (k) {
+			case 1:
+				buffer[n++]= (char)c;
+				break;
+			case 2:
+				buffer[n++]= (char)(0xc0 | (c >> 6));
+				buffer[n++]= (char)(0x80 | (c & 0x3f));
+				break;
+			case 3:
+				buffer[n++]= (char)(0xe0 | (c >> 12));
+				buffer[n++]= (char)(0x80 | ((c >> 6) & 0x3f));
+				buffer[n++]= (char)(0x80 | (c & 0x3f));
+				break;
+			default:
+				buffer[n++]= (char)(0xf0 | (c >> 18));
+				buffer[n++]= (char)(0x80 | ((c >> 12) & 0x3f));
+				buffer[n++]= (char)(0x80 | ((c >> 6) & 0x3f));
+				buffer[n++]= (char)(0x80 | (c & 0x3f));
+				break;
+		}
+	}
+	return n;
+}
@@ -0,0 +1,22 @@
+/*
+ *	berval.h
+ *
+ *	Includefile for berval.c
+ */
+
+#ifndef __BERVAL_H__
+#define __BERVAL_H__
+
+#include "vlARGS.h"
+#include "berhdr.h"
+
+EXTERN int		 berGetBoolean (const byte *, long, int *);
+EXTERN int		 berGetInteger (const byte *, long, long *);
+EXTERN long		 berGetBigInteger (const byte *, long, int, char *, long, unsigned long *);
+EXTERN int		 berGetOid (const byte *, long, char *, int);
+EXTERN long		 berGetBitString (const byte *, long);
+EXTERN int		 berGetTime (const byte *, long, int, char *, int);
+EXTERN int		 berGetReal (const byte *, long, double *);
+EXTERN long		 berGetUnicode (const byte *, long, int, char *, long);
+
+#endif
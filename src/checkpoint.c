@@ -0,0 +1,117 @@
+/*
+ *	checkpoint.c
+ *
+ *	Remember where a dump ended, so that the next run of an append-only
+ *	file only decodes what was added.
+ */
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	<string.h>
+# include	"checkpoint.h"
+
+# define	CPWINDOW		65536L		/* bytes hashed at the start and before the offset */
+# define	CPMAGIC			"asn1dump-checkpoint"
+
+static hash64	 Hash (const byte *, long, long, long);
+
+
+/*:>* checkpoint.c **********************************************************
+
+Name
+	cpMark
+
+Info
+	Checkpoint of a dump
+
+Syntax
+	void cpMark (Checkpoint *cp, const byte *data, long offset);
+	int cpCheck (const Checkpoint *cp, const byte *data, long length);
+	int cpLoad (Checkpoint *cp, const char *fn);
+	int cpSave (const Checkpoint *cp, const char *fn);
+
+Include
+	checkpoint.h
+
+Description
+	`cpMark()` sets `cp` to `offset` in `data`, the end of the last
+	element decoded completely, and a hash of the bytes before it. Only
+	the first and the last CPWINDOW bytes before `offset` are hashed, so a
+	checkpoint costs the same at any offset. That is enough to tell a file
+	which was appended to from one which was replaced.$
+	`cpCheck()` tells whether `data` of `length` bytes starts with the
+	bytes `cp` was made from, so decoding may go on at `cp->offset`.$
+	`cpLoad()` reads the checkpoint file `fn` into `cp`, `cpSave()` writes
+	`cp` to it. The file is written under a temporary name and renamed, a
+	run which is killed leaves the old checkpoint.
+
+Return value
+	`cpCheck()` returns 0 if the data matches, otherwise -1. `cpLoad()`
+	returns `cpOK`, `cpNONE` if the file doesn't exist or `cpBROKEN`.
+	`cpSave()` returns 0 or -1 if the file can't be written.
+
+Example
+	% if (cpLoad (&cp, "cdr.chk") == cpOK && cpCheck (&cp, map, length) == 0)
+	%	pos= cp.offset;
+	% ...
+	% cpMark (&cp, map, pos);
+	% cpSave (&cp, "cdr.chk");
+
+**************************************************************************<:*/
+
+void cpMark (Checkpoint *cp, const byte *data, long offset) {
+	cp->offset= offset;
+	cp->head= offset < CPWINDOW ? offset : CPWINDOW;
+	cp->tail= offset - cp->head < CPWINDOW ? offset - cp->head : CPWINDOW;
+	cp->hash= Hash (data, offset, cp->head, cp->tail);
+}
+
+int cpCheck (const Checkpoint *cp, const byte *data, long length) {
+	if (cp->offset > length || cp->head + cp->tail > cp->offset)
+		return -1;
+	return Hash (data, cp->offset, cp->head, cp->tail) == cp->hash ? 0 : -1;
+}
+
+int cpLoad (Checkpoint *cp, const char *fn) {
+	FILE	*fp;
+	char	 magic[32];
+	int		 n;
+
+	if ((fp= fopen (fn, "r")) == NULL)
+		return cpNONE;
+	n= fscanf (fp, "%31s %ld %ld %ld %llx", magic, &cp->offset, &cp->head, &cp->tail, &cp->hash);
+	fclose (fp);
+	if (n != 5 || strcmp (magic, CPMAGIC) != 0 ||
+		cp->offset < 0 || cp->head < 0 || cp->tail < 0 || cp->head + cp->tail > cp->offset)
+		return cpBROKEN;
+	return cpOK;
+}
+
+int cpSave (const Checkpoint *cp, const char *fn) {
+	FILE	*fp;
+	char	*tmp;
+	int		 rc;
+
+	if ((tmp= malloc (strlen (fn) + 5)) == NULL)
+		return -1;
+	sprintf (tmp, "%s.tmp", fn);
+	rc= -1;
+	if ((fp= fopen (tmp, "w")) != NULL) {
+		fprintf (fp, "%s %ld %ld %ld %016llx\n", CPMAGIC, cp->offset, cp->head, cp->tail, cp->hash);
+		if (fclose (fp) == 0 && rename (tmp, fn) == 0)
+			rc= 0;
+		else
+			remove (tmp);
+	}
+	free (tmp);
+	return rc;
+}
+
+
+/*
+ * hash of the first head and the last tail bytes before offset
+ */
+
+static hash64 Hash (const byte *data, long offset, long head, long tail) {
+	return hashXXH64 (data + offset - tail, tail, hashXXH64 (data, head, (hash64)offset));
+}
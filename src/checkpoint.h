@@ -0,0 +1,34 @@
+/*
+ *	checkpoint.h
+ *
+ *	Includefile for checkpoint.c
+ */
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include "vlARGS.h"
+#include "berhdr.h"
+#include "hash64.h"
+
+/* Answers of cpLoad() */
+# define	cpOK			0
+# define	cpNONE			-1		/* there is no checkpoint file			*/
+# define	cpBROKEN		-2		/* the file isn't a checkpoint			*/
+
+/*
+ *	Where a run stopped and what the data before looked like
+ */
+typedef struct {
+	long		 offset;		/* end of the last complete element		*/
+	long		 head;			/* bytes at the start in the hash		*/
+	long		 tail;			/* bytes before offset in the hash		*/
+	hash64		 hash;
+} Checkpoint;
+
+EXTERN void		 cpMark (Checkpoint *, const byte *, long);
+EXTERN int		 cpCheck (const Checkpoint *, const byte *, long);
+EXTERN int		 cpLoad (Checkpoint *, const char *);
+EXTERN int		 cpSave (const Checkpoint *, const char *);
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ *	endcache.c
+ *
+ *	Find the end of an element by its headers only, and remember the ends
+ *	of indefinite length elements found on the way.
+ */
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	<string.h>
+# include	"endcache.h"
+
+
+static void	 Store (EndCache *, long, long);
+static long	 Lookup (EndCache *, long);
+
+# define	SLOT(c,pos)		((long)(((unsigned long)(pos) * 2654435761UL) & ((c)->size - 1)))
+
+
+/*:>* endcache.c ************************************************************
+
+Name
+	ecInit
+
+Info
+	Prepare a cache of element ends
+
+Syntax
+	int ecInit (EndCache *cache, long size);
+	void ecFree (EndCache *cache);
+
+Include
+	endcache.h
+
+Description
+	`ecInit()` allocates a cache of `size` (rounded up to a power of 2,
+	0 for the default of 4096) entries. The cache is direct mapped: a new
+	entry replaces the one in its slot, so the memory stays the same
+	however many elements are scanned. `ecFree()` releases it.
+
+Return value
+	`ecInit()` returns 0 or -1 if there isn't enough memory.
+
+See also
+	ecFindEnd
+
+**************************************************************************<:*/
+
+int ecInit (EndCache *c, long size) {
+	long	 i;
+
+	memset (c, 0, sizeof(EndCache));
+	for (c->size= 1; c->size < (size > 0 ? size : 4096); c->size*= 2)
+		;
+	c->start= malloc (c->size * sizeof(long));
+	c->end= malloc (c->size * sizeof(long));
+	if (c->start == NULL || c->end == NULL) {
+		ecFree (c);
+		return -1;
+	}
+	for (i= 0; i < c->size; i++)
+		c->start[i]= -1;
+	return 0;
+}
+
+void ecFree (EndCache *c) {
+	free (c->start);
+	free (c->end);
+	free (c->stack);
+	memset (c, 0, sizeof(EndCache));
+}
+
+
+/*:>* endcache.c ************************************************************
+
+Name
+	ecFindEnd
+
+Info
+	Find the end of an element without decoding it
+
+Syntax
+	long ecFindEnd (EndCache *cache, const byte *data, long length, long pos);
+
+Include
+	endcache.h
+
+Description
+	`ecFindEnd()` returns the offset behind the element at `pos` of
+	`data`, which is `length` bytes long. For a definite length this is
+	taken from the header. The end of an indefinite length element is
+	found by walking the headers of its descendants, skipping those with
+	a definite length in one step, until the matching end-of-contents
+	octets. Nothing is allocated per element and no values are decoded.$
+	If `cache` isn't NULL, the end of every indefinite length element
+	passed on the way is stored in it, and elements whose end is in the
+	cache are skipped without walking them again, if they end within
+	`length`. So finding the end of an element and then of its children,
+	as a renderer or a splitter does, costs one walk.
+
+Return value
+	The function returns the offset behind the element, `berTRUNCATED`
+	if the element doesn't end within `length` or `berBADLENGTH` if it
+	contains an invalid header.
+
+Example
+	% if ((next= ecFindEnd (&cache, map, flength, pos)) < 0)
+	%	return -1;
+
+See also
+	ecInit, berReadHeader
+
+**************************************************************************<:*/
+
+long ecFindEnd (EndCache *c, const byte *data, long length, long pos) {
+	BerHeader	 hdr;
+	long		 p,
+				 sp,
+				 end,
+				*stack;
+	int			 rc;
+
+	if ((rc= berReadHeader (data + pos, length - pos, &hdr)) < 0)
+		return rc;
+	if (hdr.length != -1)
+		return (hdr.length <= length - pos - hdr.hdrlen) ? pos + hdr.hdrlen + hdr.length : berTRUNCATED;
+	if (hdr.pc == berPRIMITIVE)
+		return berBADLENGTH;
+	if (c != NULL && (end= Lookup (c, pos)) != -1)
+		return (end <= length) ? end : berTRUNCATED;
+
+	/* walk the headers, the stack holds the open indefinite elements */
+	sp= 0;
+	p= pos;
+	for (;;) {
+		if (c != NULL) {
+			if (sp >= c->stacksize) {
+				if ((stack= realloc (c->stack, (c->stacksize + 64) * sizeof(long))) == NULL)
+					c= NULL;				/* go on without caching */
+				else {
+					c->stack= stack;
+					c->stacksize+= 64;
+				}
+			}
+			if (c != NULL)
+				c->stack[sp]= p;
+		}
+		sp++;
+		p+= hdr.hdrlen;
+
+		for (;;) {
+			if ((rc= berReadHeader (data + p, length - p, &hdr)) < 0)
+				return rc;
+			if (berIsEOC (&hdr)) {
+				p+= 2;
+				if (c != NULL)
+					Store (c, c->stack[sp - 1], p);
+				if (--sp == 0)
+					return p;
+			} else if (hdr.length != -1) {
+				if (hdr.length > length - p - hdr.hdrlen)
+					return berTRUNCATED;
+				p+= hdr.hdrlen + hdr.length;
+			} else if (hdr.pc == berPRIMITIVE)
+				return berBADLENGTH;
+			else if (c != NULL && (end= Lookup (c, p)) != -1) {
+				if (end > length)
+					return berTRUNCATED;	/* cached when it was found in more data */
+				p= end;
+			} else
+				break;						/* open a nested element */
+		}
+	}
+}
+
+
+/*
+ * cache access
+ */
+
+static long Lookup (EndCache *c, long pos) {
+	long	 i;
+
+	c->lookups++;
+	i= SLOT (c, pos);
+	if (c->start[i] != pos)
+		return -1;
+	c->hits++;
+	return c->end[i];
+}
+
+static void Store (EndCache *c, long pos, long end) {
+	long	 i;
+
+	i= SLOT (c, pos);
+	c->start[i]= pos;
+	c->end[i]= end;
+}
@@ -0,0 +1,31 @@
+/*
+ *	endcache.h
+ *
+ *	Includefile for endcache.c
+ */
+
+#ifndef __ENDCACHE_H__
+#define __ENDCACHE_H__
+
+#include "vlARGS.h"
+#include "berhdr.h"
+
+/*
+ *	Cache of the ends of indefinite length elements, direct mapped by
+ *	the offset of the element
+ */
+typedef struct {
+	long		 size;			/* number of slots, a power of 2		*/
+	long		*start;			/* offset of the element, -1 if free	*/
+	long		*end;			/* offset behind its end-of-contents	*/
+	long		*stack;			/* open elements while scanning			*/
+	long		 stacksize;
+	long		 lookups;		/* statistics							*/
+	long		 hits;
+} EndCache;
+
+EXTERN int		 ecInit (EndCache *, long);
+EXTERN void		 ecFree (EndCache *);
+EXTERN long		 ecFindEnd (EndCache *, const byte *, long, long);
+
+#endif
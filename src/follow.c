@@ -0,0 +1,106 @@
+/*
+ *	follow.c
+ *
+ *	Wait for a file to grow, with inotify on Linux and by polling
+ *	elsewhere.
+ */
+
+# if defined(__TURBOC__) | defined(__WATCOMC__)
+# include	<io.h>
+# include	<dos.h>
+# define	sleep(s)	delay ((s) * 1000)
+# else
+# include	<unistd.h>
+# endif
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	<fcntl.h>
+# include	"fileleng.h"
+# include	"follow.h"
+
+# if defined(__linux__)
+# define	HAS_INOTIFY
+# include	<sys/inotify.h>
+# endif
+
+# ifndef O_BINARY
+# define	O_BINARY	0
+# endif
+
+
+/*:>* follow.c **************************************************************
+
+Name
+	flOpen
+
+Info
+	Follow a growing file
+
+Syntax
+	int flOpen (Follow *f, const char *fn);
+	long flWait (Follow *f, long length);
+	void flClose (Follow *f);
+
+Include
+	follow.h
+
+Description
+	`flOpen()` opens the file `fn` to watch it. The open file is followed,
+	as with "tail -f", so a file which is renamed while it is written is
+	still watched.$
+	`flWait()` blocks until the file is longer than `length` bytes. On
+	Linux it sleeps in inotify until the file is modified, elsewhere the
+	length is checked once per second.$
+	`flClose()` stops watching.
+
+Return value
+	`flOpen()` returns 0 or -1 if the file can't be opened. `flWait()`
+	returns the new length of the file, or -1 if the file became shorter
+	than `length`, i.e. it was truncated.
+
+Example
+	% while ((length= flWait (&f, length)) != -1)
+	%	DecodeUpTo (length);
+
+**************************************************************************<:*/
+
+int flOpen (Follow *f, const char *fn) {
+	f->notify= -1;
+	if ((f->fd= open (fn, O_RDONLY | O_BINARY)) == -1)
+		return -1;
+# ifdef HAS_INOTIFY
+	if ((f->notify= inotify_init ()) != -1 &&
+		inotify_add_watch (f->notify, fn, IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB) == -1) {
+		close (f->notify);
+		f->notify= -1;				/* poll instead */
+	}
+# endif
+	return 0;
+}
+
+long flWait (Follow *f, long length) {
+	long	 now;
+# ifdef HAS_INOTIFY
+	char	 events[4096];
+# endif
+
+	for (;;) {
+		now= filelength (f->fd);
+		if (now > length)
+			return now;
+		if (now < length)
+			return -1;
+# ifdef HAS_INOTIFY
+		if (f->notify != -1 && read (f->notify, events, sizeof(events)) > 0)
+			continue;
+# endif
+		sleep (1);
+	}
+}
+
+void flClose (Follow *f) {
+	if (f->notify != -1)
+		close (f->notify);
+	close (f->fd);
+}
@@ -0,0 +1,24 @@
+/*
+ *	follow.h
+ *
+ *	Includefile for follow.c
+ */
+
+#ifndef __FOLLOW_H__
+#define __FOLLOW_H__
+
+#include "vlARGS.h"
+
+/*
+ *	A file which is watched while it grows
+ */
+typedef struct {
+	int			 fd;			/* the file, followed by its inode		*/
+	int			 notify;		/* inotify descriptor, -1 to poll		*/
+} Follow;
+
+EXTERN int		 flOpen (Follow *, const char *);
+EXTERN long		 flWait (Follow *, long);
+EXTERN void		 flClose (Follow *);
+
+#endif
@@ -592,3 +592,312 @@ void
 argsIgnoreCase(const int value) {
 	ignorecase = value;
 }
+
+
+/*:>* getargs.c *************************************************************
+
+Name
+	getoptions
+
+Chapter
+	The Q Series / Command Line Parsing
+
+Info
+	Parse all command line arguments in one pass
+
+Syntax
+	int getoptions (const ArgsOption *options, const int argc, char *argv[],
+					char ***operands);
+	const char *argsError (void);
+
+Include
+	getargs.h
+
+Section
+	Command line parsing
+
+Description
+	`getoptions()` walks through `argv` once and sets the variables of
+	the `options` table, which ends with an entry whose `name` is 0. An
+	option is given by its `name` or its `longname`, a `longname` may be
+	followed by its value as in `--threads=4`. `argsFLAG` options set an
+	int to 1, the others take the next argument as their value.
+	`argsSTRING` values point into the arguments, `argsDOUBLE` values
+	may have a fraction and an exponent.$
+	An argument `@file` is replaced by the arguments in `file`, which are
+	separated by white space and may be quoted with `"` or `'`. Response
+	files may include other response files. The memory for their
+	arguments is never released, as the values point into it.$
+	All other arguments, and all arguments behind `--` (`ARGS_EOA`), are
+	operands. They are returned in `*operands`, a 0 terminated array.$
+	Unlike the other functions, which search `argv` for each option, the
+	cost is linear in the number of arguments. `argsIgnoreCase()` is
+	respected.
+
+Return value
+	The function returns the number of operands or -1 for an unknown
+	option, a missing or invalid value or an unreadable response file.
+	`argsError()` then returns a message about it.
+
+Example
+	% static ArgsOption options[]= {
+	%	{ "-verbose", "--verbose", argsFLAG, &verbose },
+	%	{ "-length", "--length", argsINT, &length },
+	%	{ 0, 0, 0, 0 }
+	% };
+	% char	**files;
+	%
+	% if (getoptions (options, argc, argv, &files) < 1)
+	%	fprintf (stderr, "%s\n", argsError ());
+
+See also
+	is_arg
+	stringval
+
+**************************************************************************<:*/
+
+# define	MAXNESTING	8			/* of response files */
+
+typedef struct {
+	char	**list;
+	int		  count;
+	int		  size;
+	int		  eoa;				/* operands only from here on */
+} Operands;
+
+static char	  errortext[256];
+
+static int	  AddOperand(Operands *, char *);
+static const ArgsOption *FindOption(const ArgsOption *, const char *, const char **);
+static int	  ParseArgs(const ArgsOption *, const int, char **, const int, Operands *);
+static char	**ReadResponseFile(const char *, int *);
+static int	  SetOption(const ArgsOption *, const char *);
+
+
+int
+getoptions(const ArgsOption *options, const int argc, char * argv[], char ***operands) {
+	Operands	 ops;
+
+	memset(&ops, 0, sizeof(ops));
+	errortext[0] = '\0';
+	if (AddOperand(&ops, 0) == -1 || 
+		(argc > 1 && ParseArgs(options, argc - 1, argv + 1, 0, &ops) == -1)) {
+		free(ops.list);
+		*operands = 0;
+		return -1;
+	}
+	*operands = ops.list;
+	return ops.count;
+}
+
+const char *
+argsError() {
+	return errortext;
+}
+
+
+/*
+ *	one level of arguments, from the command line or a response file
+ */
+
+static int
+ParseArgs(const ArgsOption *options, const int argc, char * argv[], const int depth, Operands *ops) {
+	const ArgsOption	*opt;
+	const char			*value;
+	char				**args;
+	int					  i,
+						  n;
+
+	for (i = 0; i < argc; i++) {
+		if (ops->eoa) {
+			if (AddOperand(ops, argv[i]) == -1)
+				return -1;
+			continue;
+		}
+		if (streq(argv[i], ARGS_EOA)) {
+			ops->eoa = 1;
+			continue;
+		}
+		if (argv[i][0] == '@' && argv[i][1] != '\0') {
+			if (depth >= MAXNESTING) {
+				sprintf(errortext, "response files nested too deeply at '%.200s'", argv[i]);
+				return -1;
+			}
+			if ((args = ReadResponseFile(argv[i] + 1, &n)) == 0)
+				return -1;
+			if (ParseArgs(options, n, args, depth + 1, ops) == -1)
+				return -1;
+			continue;
+		}
+		if (argv[i][0] != '-' || argv[i][1] == '\0') {
+			if (AddOperand(ops, argv[i]) == -1)
+				return -1;
+			continue;
+		}
+
+		if ((opt = FindOption(options, argv[i], &value)) == 0) {
+			sprintf(errortext, "unknown option '%.200s'", argv[i]);
+			return -1;
+		}
+		if (opt->type == argsFLAG) {
+			if (value != 0) {
+				sprintf(errortext, "option '%.200s' doesn't take a value", opt->name);
+				return -1;
+			}
+			*(int *)opt->value = 1;
+			continue;
+		}
+		if (value == 0) {
+			if (i + 1 >= argc) {
+				sprintf(errortext, "option '%.200s' needs a value", opt->name);
+				return -1;
+			}
+			value = argv[++i];
+		}
+		if (SetOption(opt, value) == -1) {
+			sprintf(errortext, "option '%.100s' needs a number, not '%.100s'", opt->name, value);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static const ArgsOption *
+FindOption(const ArgsOption *options, const char *arg, const char **value) {
+	const char	*eq;
+	size_t		 len;
+
+	*value = 0;
+	len = strlen(arg);
+	if (arg[1] == '-' && (eq = strchr(arg, '=')) != 0)
+		len = (size_t)(eq - arg);		/* --name=value */
+	for (; options->name != 0; options++) {
+		if (len == strlen(arg)) {
+			if ((ignorecase ? stricmp(arg, options->name) : strcmp(arg, options->name)) == 0)
+				return options;
+		}
+		if (options->longname != 0 && strlen(options->longname) == len &&
+			(ignorecase ? strnicmp(arg, options->longname, len) : strncmp(arg, options->longname, len)) == 0) {
+			if (len < strlen(arg))
+				*value = arg + len + 1;
+			return options;
+		}
+	}
+	return 0;
+}
+
+static int
+SetOption(const ArgsOption *opt, const char *value) {
+	char	*end;
+	long	 l;
+
+	if (opt->type == argsSTRING) {
+		*(const char **)opt->value = value;
+		return 0;
+	}
+	if (opt->type == argsDOUBLE) {
+		*(double *)opt->value = strtod(value, &end);
+		return (end == value || *end != '\0') ? -1 : 0;
+	}
+	l = strtol(value, &end, 10);
+	if (end == value || *end != '\0')
+		return -1;
+	if (opt->type == argsINT)
+		*(int *)opt->value = (int)l;
+	else
+		*(long *)opt->value = l;
+	return 0;
+}
+
+static int
+AddOperand(Operands *ops, char *arg) {
+	char	**list;
+
+	if (ops->count + 1 >= ops->size) {
+		if ((list = realloc(ops->list, (ops->size + 64) * sizeof(char *))) == 0) {
+			sprintf(errortext, "not enough memory for the arguments");
+			return -1;
+		}
+		ops->list = list;
+		ops->size += 64;
+	}
+	if (arg != 0)
+		ops->list[ops->count++] = arg;
+	ops->list[ops->count] = 0;
+	return 0;
+}
+
+
+/*
+ *	read the arguments of a response file into an array
+ */
+
+static char **
+ReadResponseFile(const char *fn, int *count) {
+	FILE	 *fp;
+	char	 *text,
+			 *p,
+			 *q,
+			**args,
+			**more;
+	long	  length,
+			  n;
+	int		  size,
+			  quote;
+
+	if ((fp = fopen(fn, "r")) == 0) {
+		sprintf(errortext, "can't read response file '%.200s'", fn);
+		return 0;
+	}
+	text = 0;
+	length = 0;
+	do {
+		if ((p = realloc(text, (size_t)length + 4097)) == 0) {
+			free(text);
+			fclose(fp);
+			sprintf(errortext, "not enough memory for response file '%.200s'", fn);
+			return 0;
+		}
+		text = p;
+		n = (long)fread(text + length, 1, 4096, fp);
+		length += n;
+	} while (n == 4096);
+	fclose(fp);
+	text[length] = '\0';
+
+	size = 256;
+	if ((args = malloc(size * sizeof(char *))) == 0) {
+		sprintf(errortext, "not enough memory for response file '%.200s'", fn);
+		return 0;
+	}
+	*count = 0;
+	for (p = text; ; ) {
+		while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+			p++;
+		if (*p == '\0')
+			break;
+		if (*count >= size) {
+			if ((more = realloc(args, (size + 256) * sizeof(char *))) == 0) {
+				sprintf(errortext, "not enough memory for response file '%.200s'", fn);
+				return 0;
+			}
+			args = more;
+			size += 256;
+		}
+		args[(*count)++] = q = p;		/* the argument is unquoted in place */
+		for (quote = 0; *p != '\0'; p++) {
+			if (quote != 0 && *p == quote)
+				quote = 0;
+			else if (quote == 0 && (*p == '"' || *p == '\''))
+				quote = *p;
+			else if (quote == 0 && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+				break;
+			else
+				*q++ = *p;
+		}
+		if (*p != '\0')
+			p++;
+		*q = '\0';
+	}
+	return args;
+}
@@ -14,6 +14,22 @@
 
 # define	ARGS_EOA	"--"
 
+/*
+ *	Option table for getoptions()
+ */
+# define	argsFLAG	0		/* int, set to 1 if the option is given	*/
+# define	argsINT		1		/* int value							*/
+# define	argsLONG	2		/* long value							*/
+# define	argsSTRING	3		/* char *, points into the arguments	*/
+# define	argsDOUBLE	4		/* double value							*/
+
+typedef struct {
+	const char	*name;				/* e.g. "-threads"						*/
+	const char	*longname;			/* e.g. "--threads", or 0				*/
+	int			 type;
+	void		*value;				/* variable to set						*/
+} ArgsOption;
+
 EXTERN float	 floatval(const char *, const int, char **);
 EXTERN int		 intval(const char *, const int, char **);
 EXTERN int		 getindex(void);
@@ -24,6 +40,8 @@ EXTERN char		*nextval(const int, char **);
 EXTERN char		*stringval(const char *, const int, char **);
 EXTERN void		 skiparg(const char *, const int, const int, char **);
 EXTERN void		 argsIgnoreCase(const int);
+EXTERN int		 getoptions(const ArgsOption *, const int, char **, char ***);
+EXTERN const char *argsError(void);
 
 # define ASSIGNSTRVAL(s,opt,argc,argv)	{ char *tmp=stringval(opt,argc,argv); if (tmp) s= tmp; }
 
@@ -65,6 +83,9 @@ public:
 	void	 reset();							// Reset the internal counter 
 	int		 count() const;						// Get number of arguments
 	void	 ignorecase(const bool);			// Ignore the case of the parameter
+
+	int		 options(const ArgsOption *table, char ***operands)	// Parse all options
+				{ return getoptions(table, argc, argv, operands); }	// in one pass
 };
 
 # endif /* __cplusplus */
@@ -0,0 +1,222 @@
+/*
+ *	hash64.c
+ *
+ *	64 bit hash of encodings and a set of encodings to find duplicates.
+ */
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	<string.h>
+# include	"hash64.h"
+
+
+static int	 Grow (HashSet *);
+
+
+# define	PRIME1		0x9E3779B185EBCA87ULL
+# define	PRIME2		0xC2B2AE3D27D4EB4FULL
+# define	PRIME3		0x165667B19E3779F9ULL
+# define	PRIME4		0x85EBCA77C2B2AE63ULL
+# define	PRIME5		0x27D4EB2F165667C5ULL
+
+# define	ROTL(x,r)	(((x) << (r)) | ((x) >> (64 - (r))))
+# define	ROUND(acc,in)	((acc)+= (in) * PRIME2, (acc)= ROTL(acc, 31), (acc)*= PRIME1)
+
+/* little endian reads, a single load on most machines */
+# define	READ32(p)	((hash64)(p)[0] | (hash64)(p)[1] << 8 | \
+						 (hash64)(p)[2] << 16 | (hash64)(p)[3] << 24)
+# define	READ64(p)	(READ32(p) | READ32((p) + 4) << 32)
+
+
+/*:>* hash64.c **************************************************************
+
+Name
+	hashXXH64
+
+Info
+	Compute the 64 bit xxHash of a byte range
+
+Syntax
+	hash64 hashXXH64 (const byte *data, long length, hash64 seed);
+
+Include
+	hash64.h
+
+Description
+	`hashXXH64()` computes the XXH64 hash of the `length` bytes at `data`.
+	The bulk of the data is consumed in stripes of 32 bytes by four
+	independent accumulators, so the multiplications of the lanes overlap
+	in the pipeline. The result is the same as of the reference
+	implementation of xxHash with the same `seed`.
+
+Return value
+	The function returns the hash value.
+
+Example
+	% printf ("%016llx\n", hashXXH64 (map + pos, hdr.hdrlen + hdr.length, 0));
+
+See also
+	hsInsert
+
+**************************************************************************<:*/
+
+hash64 hashXXH64 (const byte *p, long length, hash64 seed) {
+	const byte	*end;
+	hash64		 v1, v2, v3, v4,
+				 h,
+				 k;
+
+	end= p + length;
+	if (length >= 32) {
+		v1= seed + PRIME1 + PRIME2;
+		v2= seed + PRIME2;
+		v3= seed;
+		v4= seed - PRIME1;
+		do {
+			ROUND (v1, READ64 (p));
+			ROUND (v2, READ64 (p + 8));
+			ROUND (v3, READ64 (p + 16));
+			ROUND (v4, READ64 (p + 24));
+			p+= 32;
+		} while (p <= end - 32);
+
+		h= ROTL (v1, 1) + ROTL (v2, 7) + ROTL (v3, 12) + ROTL (v4, 18);
+		k= 0; ROUND (k, v1); h^= k; h= h * PRIME1 + PRIME4;
+		k= 0; ROUND (k, v2); h^= k; h= h * PRIME1 + PRIME4;
+		k= 0; ROUND (k, v3); h^= k; h= h * PRIME1 + PRIME4;
+		k= 0; ROUND (k, v4); h^= k; h= h * PRIME1 + PRIME4;
+	} else
+		h= seed + PRIME5;
+
+	h+= (hash64)length;
+	for ( ; p + 8 <= end; p+= 8) {
+		k= 0;
+		ROUND (k, READ64 (p));
+		h^= k;
+		h= ROTL (h, 27) * PRIME1 + PRIME4;
+	}
+	if (p + 4 <= end) {
+		h^= READ32 (p) * PRIME1;
+		h= ROTL (h, 23) * PRIME2 + PRIME3;
+		p+= 4;
+	}
+	for ( ; p < end; p++) {
+		h^= *p * PRIME5;
+		h= ROTL (h, 11) * PRIME1;
+	}
+
+	h^= h >> 33;
+	h*= PRIME2;
+	h^= h >> 29;
+	h*= PRIME3;
+	h^= h >> 32;
+	return h;
+}
+
+
+/*:>* hash64.c **************************************************************
+
+Name
+	hsInsert
+
+Info
+	Add an encoding to a set, find duplicates
+
+Syntax
+	void hsInit (HashSet *set, const byte *data);
+	long hsInsert (HashSet *set, hash64 hash, long offset, long length);
+	void hsFree (HashSet *set);
+
+Include
+	hash64.h
+
+Description
+	A `HashSet` holds encodings which are identified by their `offset`
+	and `length` in `data`, only the offsets and hashes are stored.
+	`hsInit()` prepares an empty set, `hsFree()` releases its memory.$
+	`hsInsert()` looks for an encoding with the same bytes as the
+	`length` bytes at `offset`, whose `hash` must be given. If there is
+	none, the encoding is added to the set.$
+	The set uses open addressing with linear probing in a table of
+	parallel arrays, which is doubled when it is half full. Equal hashes
+	are confirmed with memcmp(), so collisions of the hash can't cause
+	wrong duplicates.
+
+Return value
+	`hsInsert()` returns the offset of an equal encoding in the set, -1
+	if the encoding was added and -2 if there isn't enough memory.
+
+See also
+	hashXXH64
+
+**************************************************************************<:*/
+
+void hsInit (HashSet *set, const byte *data) {
+	memset (set, 0, sizeof(HashSet));
+	set->data= data;
+}
+
+long hsInsert (HashSet *set, hash64 hash, long offset, long length) {
+	long	 i;
+
+	if (2 * (set->count + 1) > set->size && Grow (set) == -1)
+		return -2;
+
+	for (i= (long)(hash & (set->size - 1)); set->offset[i] != -1; i= (i + 1) & (set->size - 1))
+		if (set->hash[i] == hash && set->length[i] == length &&
+			memcmp (set->data + set->offset[i], set->data + offset, (size_t)length) == 0)
+			return set->offset[i];
+
+	set->hash[i]= hash;
+	set->offset[i]= offset;
+	set->length[i]= length;
+	set->count++;
+	return -1;
+}
+
+void hsFree (HashSet *set) {
+	free (set->hash);
+	free (set->offset);
+	free (set->length);
+	hsInit (set, set->data);
+}
+
+
+/*
+ * double the size of the table and rehash the entries
+ */
+
+static int Grow (HashSet *set) {
+	HashSet	 grown;
+	long	 i,
+			 j;
+
+	grown= *set;
+	grown.size= set->size ? 2 * set->size : 1024;
+	grown.hash= malloc (grown.size * sizeof(hash64));
+	grown.offset= malloc (grown.size * sizeof(long));
+	grown.length= malloc (grown.size * sizeof(long));
+	if (grown.hash == NULL || grown.offset == NULL || grown.length == NULL) {
+		free (grown.hash);
+		free (grown.offset);
+		free (grown.length);
+		return -1;
+	}
+	for (j= 0; j < grown.size; j++)
+		grown.offset[j]= -1;
+
+	for (i= 0; i < set->size; i++) {
+		if (set->offset[i] == -1)
+			continue;
+		for (j= (long)(set->hash[i] & (grown.size - 1)); grown.offset[j] != -1; j= (j + 1) & (grown.size - 1))
+			;
+		grown.hash[j]= set->hash[i];
+		grown.offset[j]= set->offset[i];
+		grown.length[j]= set->length[i];
+	}
+	free (set->hash);
+	free (set->offset);
+	free (set->length);
+	*set= grown;
+	return 0;
+}
@@ -0,0 +1,32 @@
+/*
+ *	hash64.h
+ *
+ *	Includefile for hash64.c
+ */
+
+#ifndef __HASH64_H__
+#define __HASH64_H__
+
+#include "vlARGS.h"
+#include "berhdr.h"
+
+typedef unsigned long long	hash64;
+
+/*
+ *	Set of encodings, identified by their position in the data
+ */
+typedef struct {
+	const byte	*data;			/* the data the offsets refer to		*/
+	long		 size;			/* number of slots, a power of 2		*/
+	long		 count;			/* number of used slots					*/
+	hash64		*hash;			/* hash of the encoding in the slot		*/
+	long		*offset;		/* offset of the encoding, -1 if free	*/
+	long		*length;		/* length of the encoding				*/
+} HashSet;
+
+EXTERN hash64	 hashXXH64 (const byte *, long, hash64);
+EXTERN void		 hsInit (HashSet *, const byte *);
+EXTERN long		 hsInsert (HashSet *, hash64, long, long);
+EXTERN void		 hsFree (HashSet *);
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ *	mapfile.c
+ *
+ *	Map a whole file read-only into memory. Where mmap() isn't available
+ *	the file is read into an allocated buffer instead.
+ */
+
+# if defined(__linux__)
+# define	_GNU_SOURCE				/* copy_file_range() */
+# endif
+
+# if defined(__TURBOC__) | defined(__WATCOMC__)
+# include	<io.h>
+# include	<fcntl.h>
+# else
+# define	HAS_MMAP
+# include	<sys/types.h>
+# include	<sys/mman.h>
+# include	<fcntl.h>
+# include	<unistd.h>
+# endif
+
+# if defined(__linux__)
+# define	HAS_SENDFILE
+# include	<sys/sendfile.h>
+# if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+# define	HAS_COPY_FILE_RANGE
+# endif
+# endif
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	"fileleng.h"
+# include	"mapfile.h"
+
+# ifndef O_BINARY
+# define	O_BINARY	0
+# endif
+
+static int	 Map (MappedFile *);
+
+/*:>* mapfile.c *************************************************************
+
+Name
+	mapOpen
+
+Info
+	Map a file into memory
+
+Syntax
+	int mapOpen (MappedFile *mf, const char *fn);
+
+Include
+	mapfile.h
+
+Description
+	`mapOpen()` opens the file `fn` and makes its whole content available
+	in `mf->data`. The length of the file is stored in `mf->length`.
+
+Return value
+	The function returns 0 on success or -1 if the file can't be opened or
+	mapped.
+
+See also
+	mapClose
+
+**************************************************************************<:*/
+
+int mapOpen (MappedFile *mf, const char *fn) {
+	mf->data= NULL;
+	mf->mapped= 0;
+	if ((mf->fd= open (fn, O_RDONLY | O_BINARY)) == -1)
+		return -1;
+	mf->length= filelength (mf->fd);
+	if (mf->length <= 0) {
+		mf->length= 0;
+		return 0;
+	}
+	if (Map (mf) == -1) {
+		close (mf->fd);
+		mf->fd= -1;
+		return -1;
+	}
+	return 0;
+}
+
+
+/*:>* mapfile.c *************************************************************
+
+Name
+	mapRefresh
+
+Info
+	Map a file again after it has grown
+
+Syntax
+	int mapRefresh (MappedFile *mf);
+
+Include
+	mapfile.h
+
+Description
+	`mapRefresh()` maps the file of `mf` again with its current length,
+	if that has changed. `mf->data` changes then, offsets into it stay
+	valid as long as the file is only appended to.
+
+Return value
+	The function returns 0 on success or -1 if the file can't be mapped.
+
+See also
+	mapOpen
+
+**************************************************************************<:*/
+
+int mapRefresh (MappedFile *mf) {
+	long	 length;
+
+	if ((length= filelength (mf->fd)) == mf->length)
+		return 0;
+	if (mf->data) {
+# ifdef HAS_MMAP
+		if (mf->mapped)
+			munmap ((void *)mf->data, (size_t)mf->length);
+		else
+# endif
+			free ((void *)mf->data);
+	}
+	mf->data= NULL;
+	mf->mapped= 0;
+	mf->length= length > 0 ? length : 0;
+	if (mf->length == 0)
+		return 0;
+	lseek (mf->fd, 0L, SEEK_SET);
+	return Map (mf);
+}
+
+
+/*
+ * map mf->length bytes of the open file, or read them
+ */
+
+static int Map (MappedFile *mf) {
+	void	*p;
+
+# ifdef HAS_MMAP
+	p= mmap (NULL, (size_t)mf->length, PROT_READ, MAP_SHARED, mf->fd, 0);
+	if (p != MAP_FAILED) {
+# ifdef MADV_SEQUENTIAL
+		madvise (p, (size_t)mf->length, MADV_SEQUENTIAL);
+# endif
+		mf->data= p;
+		mf->mapped= 1;
+		return 0;
+	}
+# endif
+
+	/* fall back to reading the file */
+	if ((p= malloc ((size_t)mf->length)) == NULL ||
+		read (mf->fd, p, (size_t)mf->length) != mf->length) {
+		free (p);
+		return -1;
+	}
+	mf->data= p;
+	return 0;
+}
+
+
+/*:>* mapfile.c *************************************************************
+
+Name
+	mapClose
+
+Info
+	Release a mapped file
+
+Syntax
+	void mapClose (MappedFile *mf);
+
+Include
+	mapfile.h
+
+Description
+	`mapClose()` unmaps the file data of `mf` and closes the file.
+
+Return value
+	None
+
+See also
+	mapOpen
+
+**************************************************************************<:*/
+
+void mapClose (MappedFile *mf) {
+	if (mf->data) {
+# ifdef HAS_MMAP
+		if (mf->mapped)
+			munmap ((void *)mf->data, (size_t)mf->length);
+		else
+# endif
+			free ((void *)mf->data);
+	}
+	if (mf->fd != -1)
+		close (mf->fd);
+	mf->data= NULL;
+	mf->fd= -1;
+}
+
+
+/*:>* mapfile.c *************************************************************
+
+Name
+	mapCopy
+
+Info
+	Write a range of a mapped file to another file
+
+Syntax
+	long mapCopy (MappedFile *mf, long offset, long length, int fd);
+
+Include
+	mapfile.h
+
+Description
+	`mapCopy()` writes the `length` bytes at `offset` of the file `mf` to
+	the file descriptor `fd` at its current position.$
+	Where available the bytes are copied inside the kernel with
+	copy_file_range(), which may even share the blocks on the file system,
+	or with sendfile(), which also works for pipes. If neither works for
+	`fd` the bytes are written from the mapped data. A method that fails
+	isn't tried again by later calls.
+
+Return value
+	The function returns `length` or -1 on a write error.
+
+See also
+	mapOpen
+
+**************************************************************************<:*/
+
+long mapCopy (MappedFile *mf, long offset, long length, int fd) {
+# if defined(HAS_COPY_FILE_RANGE) || defined(HAS_SENDFILE)
+	static int	 nocopy= 0,
+				 nosend= 0;
+	off_t		 off;
+# endif
+	long		 done,
+				 n;
+
+	for (done= 0; done < length; done+= n) {
+# ifdef HAS_COPY_FILE_RANGE
+		if (!nocopy) {
+			off= (off_t)(offset + done);
+			if ((n= (long)copy_file_range (mf->fd, &off, fd, NULL, (size_t)(length - done), 0)) > 0)
+				continue;
+			nocopy= 1;			/* not between these files, or nothing copied */
+		}
+# endif
+# ifdef HAS_SENDFILE
+		if (!nosend) {
+			off= (off_t)(offset + done);
+			if ((n= (long)sendfile (fd, mf->fd, &off, (size_t)(length - done))) > 0)
+				continue;
+			nosend= 1;
+		}
+# endif
+		if ((n= (long)write (fd, mf->data + offset + done, (size_t)(length - done))) <= 0)
+			return -1;
+	}
+	return length;
+}
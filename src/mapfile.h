@@ -0,0 +1,25 @@
+/*
+ *	mapfile.h
+ *
+ *	Includefile for mapfile.c
+ */
+
+#ifndef __MAPFILE_H__
+#define __MAPFILE_H__
+
+#include "vlARGS.h"
+#include "berhdr.h"
+
+typedef struct {
+	const byte	*data;			/* content of the file					*/
+	long		 length;		/* length of the file					*/
+	int			 fd;			/* file descriptor						*/
+	int			 mapped;		/* 1: data is mmap'ed, 0: data is read	*/
+} MappedFile;
+
+EXTERN int		 mapOpen (MappedFile *, const char *);
+EXTERN int		 mapRefresh (MappedFile *);
+EXTERN void		 mapClose (MappedFile *);
+EXTERN long		 mapCopy (MappedFile *, long, long, int);
+
+#endif
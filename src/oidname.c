@@ -0,0 +1,581 @@
+/*
+ *	oidname.c
+ *
+ *	Map OBJECT IDENTIFIERs to names. The names come from a built-in table
+ *	and from mapping files. Lookups are done with the encoded content
+ *	octets of the OID through a perfect hash, so no OID has to be
+ *	converted into its dotted form to find its name.
+ */
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	<string.h>
+# include	<ctype.h>
+# include	"arena.h"
+# include	"mapfile.h"
+# include	"oidname.h"
+
+typedef struct {
+	const byte	*oid;			/* encoded content octets			*/
+	int			 oidlen;
+	const char	*name;			/* not terminated					*/
+	int			 namelen;
+	long		 seq;			/* order of definition				*/
+} OidName;
+
+/*
+ *	The built-in names, already in encoded form
+ */
+static OidName builtin[]= {
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x01\x01",   9, "rsaEncryption", 0, 0 },	/* 1.2.840.113549.1.1.1 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x01\x04",   9, "md5WithRSAEncryption", 0, 0 },	/* 1.2.840.113549.1.1.4 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x01\x05",   9, "sha1WithRSAEncryption", 0, 0 },	/* 1.2.840.113549.1.1.5 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x01\x0a",   9, "rsassaPss", 0, 0 },	/* 1.2.840.113549.1.1.10 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x01\x0b",   9, "sha256WithRSAEncryption", 0, 0 },	/* 1.2.840.113549.1.1.11 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x01\x0c",   9, "sha384WithRSAEncryption", 0, 0 },	/* 1.2.840.113549.1.1.12 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x01\x0d",   9, "sha512WithRSAEncryption", 0, 0 },	/* 1.2.840.113549.1.1.13 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x07\x01",   9, "data", 0, 0 },	/* 1.2.840.113549.1.7.1 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x07\x02",   9, "signedData", 0, 0 },	/* 1.2.840.113549.1.7.2 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x07\x03",   9, "envelopedData", 0, 0 },	/* 1.2.840.113549.1.7.3 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x09\x01",   9, "emailAddress", 0, 0 },	/* 1.2.840.113549.1.9.1 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x09\x03",   9, "contentType", 0, 0 },	/* 1.2.840.113549.1.9.3 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x09\x04",   9, "messageDigest", 0, 0 },	/* 1.2.840.113549.1.9.4 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x01\x09\x05",   9, "signingTime", 0, 0 },	/* 1.2.840.113549.1.9.5 */
+	{ (const byte *)"\x2a\x86\x48\x86\xf7\x0d\x02\x05",       8, "md5", 0, 0 },	/* 1.2.840.113549.2.5 */
+	{ (const byte *)"\x2a\x86\x48\xce\x38\x04\x01",           7, "dsa", 0, 0 },	/* 1.2.840.10040.4.1 */
+	{ (const byte *)"\x2a\x86\x48\xce\x3d\x02\x01",           7, "ecPublicKey", 0, 0 },	/* 1.2.840.10045.2.1 */
+	{ (const byte *)"\x2a\x86\x48\xce\x3d\x03\x01\x07",       8, "prime256v1", 0, 0 },	/* 1.2.840.10045.3.1.7 */
+	{ (const byte *)"\x2a\x86\x48\xce\x3d\x04\x03\x02",       8, "ecdsaWithSHA256", 0, 0 },	/* 1.2.840.10045.4.3.2 */
+	{ (const byte *)"\x2a\x86\x48\xce\x3d\x04\x03\x03",       8, "ecdsaWithSHA384", 0, 0 },	/* 1.2.840.10045.4.3.3 */
+	{ (const byte *)"\x2b\x0e\x03\x02\x1a",                   5, "sha1", 0, 0 },	/* 1.3.14.3.2.26 */
+	{ (const byte *)"\x2b\x65\x6e",                           3, "X25519", 0, 0 },	/* 1.3.101.110 */
+	{ (const byte *)"\x2b\x65\x70",                           3, "Ed25519", 0, 0 },	/* 1.3.101.112 */
+	{ (const byte *)"\x2b\x81\x04\x00\x22",                   5, "secp384r1", 0, 0 },	/* 1.3.132.0.34 */
+	{ (const byte *)"\x2b\x81\x04\x00\x23",                   5, "secp521r1", 0, 0 },	/* 1.3.132.0.35 */
+	{ (const byte *)"\x2b\x06\x01\x02\x01",                   5, "mib-2", 0, 0 },	/* 1.3.6.1.2.1 */
+	{ (const byte *)"\x2b\x06\x01\x04\x01",                   5, "enterprises", 0, 0 },	/* 1.3.6.1.4.1 */
+	{ (const byte *)"\x2b\x06\x01\x05\x05\x07\x01\x01",       8, "authorityInfoAccess", 0, 0 },	/* 1.3.6.1.5.5.7.1.1 */
+	{ (const byte *)"\x2b\x06\x01\x05\x05\x07\x03\x01",       8, "serverAuth", 0, 0 },	/* 1.3.6.1.5.5.7.3.1 */
+	{ (const byte *)"\x2b\x06\x01\x05\x05\x07\x03\x02",       8, "clientAuth", 0, 0 },	/* 1.3.6.1.5.5.7.3.2 */
+	{ (const byte *)"\x2b\x06\x01\x05\x05\x07\x30\x01",       8, "ocsp", 0, 0 },	/* 1.3.6.1.5.5.7.48.1 */
+	{ (const byte *)"\x2b\x06\x01\x05\x05\x07\x30\x02",       8, "caIssuers", 0, 0 },	/* 1.3.6.1.5.5.7.48.2 */
+	{ (const byte *)"\x60\x86\x48\x01\x65\x03\x04\x01\x02",   9, "aes128-CBC", 0, 0 },	/* 2.16.840.1.101.3.4.1.2 */
+	{ (const byte *)"\x60\x86\x48\x01\x65\x03\x04\x01\x2a",   9, "aes256-CBC", 0, 0 },	/* 2.16.840.1.101.3.4.1.42 */
+	{ (const byte *)"\x60\x86\x48\x01\x65\x03\x04\x02\x01",   9, "sha256", 0, 0 },	/* 2.16.840.1.101.3.4.2.1 */
+	{ (const byte *)"\x60\x86\x48\x01\x65\x03\x04\x02\x02",   9, "sha384", 0, 0 },	/* 2.16.840.1.101.3.4.2.2 */
+	{ (const byte *)"\x60\x86\x48\x01\x65\x03\x04\x02\x03",   9, "sha512", 0, 0 },	/* 2.16.840.1.101.3.4.2.3 */
+	{ (const byte *)"\x55\x04\x03",                           3, "commonName", 0, 0 },	/* 2.5.4.3 */
+	{ (const byte *)"\x55\x04\x04",                           3, "surname", 0, 0 },	/* 2.5.4.4 */
+	{ (const byte *)"\x55\x04\x05",                           3, "serialNumber", 0, 0 },	/* 2.5.4.5 */
+	{ (const byte *)"\x55\x04\x06",                           3, "countryName", 0, 0 },	/* 2.5.4.6 */
+	{ (const byte *)"\x55\x04\x07",                           3, "localityName", 0, 0 },	/* 2.5.4.7 */
+	{ (const byte *)"\x55\x04\x08",                           3, "stateOrProvinceName", 0, 0 },	/* 2.5.4.8 */
+	{ (const byte *)"\x55\x04\x09",                           3, "streetAddress", 0, 0 },	/* 2.5.4.9 */
+	{ (const byte *)"\x55\x04\x0a",                           3, "organizationName", 0, 0 },	/* 2.5.4.10 */
+	{ (const byte *)"\x55\x04\x0b",                           3, "organizationalUnitName", 0, 0 },	/* 2.5.4.11 */
+	{ (const byte *)"\x55\x04\x0c",                           3, "title", 0, 0 },	/* 2.5.4.12 */
+	{ (const byte *)"\x55\x04\x2a",                           3, "givenName", 0, 0 },	/* 2.5.4.42 */
+	{ (const byte *)"\x55\x04\x61",                           3, "organizationIdentifier", 0, 0 },	/* 2.5.4.97 */
+	{ (const byte *)"\x55\x1d\x0e",                           3, "subjectKeyIdentifier", 0, 0 },	/* 2.5.29.14 */
+	{ (const byte *)"\x55\x1d\x0f",                           3, "keyUsage", 0, 0 },	/* 2.5.29.15 */
+	{ (const byte *)"\x55\x1d\x11",                           3, "subjectAltName", 0, 0 },	/* 2.5.29.17 */
+	{ (const byte *)"\x55\x1d\x13",                           3, "basicConstraints", 0, 0 },	/* 2.5.29.19 */
+	{ (const byte *)"\x55\x1d\x1f",                           3, "cRLDistributionPoints", 0, 0 },	/* 2.5.29.31 */
+	{ (const byte *)"\x55\x1d\x20",                           3, "certificatePolicies", 0, 0 },	/* 2.5.29.32 */
+	{ (const byte *)"\x55\x1d\x23",                           3, "authorityKeyIdentifier", 0, 0 },	/* 2.5.29.35 */
+	{ (const byte *)"\x55\x1d\x25",                           3, "extKeyUsage", 0, 0 },	/* 2.5.29.37 */
+	{ (const byte *)"\x09\x92\x26\x89\x93\xf2\x2c\x64\x01\x19", 10, "domainComponent", 0, 0 },	/* 0.9.2342.19200300.100.1.25 */
+	{ (const byte *)"\x00\x11\x86\x05\x01\x01\x01",           7, "dialogueAs", 0, 0 },	/* 0.0.17.773.1.1.1 */
+};
+
+# define	NBUILTIN	(long)(sizeof(builtin) / sizeof(builtin[0]))
+
+static OidName		*names = NULL;		/* all names, sorted by OID				*/
+static long			 nnames = 0;
+static long			 sizenames = 0;
+static long			*slots = NULL;		/* perfect hash: slot -> name			*/
+static long			 nslots = 0;
+static unsigned long	*disp = NULL;	/* displacement of each bucket			*/
+static long			 nbuckets = 0;
+static Arena		 arena;				/* encoded OIDs from mapping files		*/
+static int			 arenaready = 0;
+
+
+static int	 AddName (const byte *, int, const char *, int, long);
+static int	 BigArc (const char *, int, unsigned long, byte *, int);
+static int	 Compare (const void *, const void *);
+static unsigned long	 Hash (const byte *, long, unsigned long);
+static int	 TryBuild (long, long);
+
+
+/*:>* oidname.c *************************************************************
+
+Name
+	oidLoadFile
+
+Info
+	Load OID names from a mapping file
+
+Syntax
+	int oidLoadFile (const char *fn);
+
+Include
+	oidname.h
+
+Description
+	`oidLoadFile()` adds the names from the mapping file `fn`. Each line
+	of the file holds an OID in dotted form and its name, separated by
+	white space. Empty lines and lines starting with '#' are ignored.
+	A name from a file replaces a built-in name or a name from an earlier
+	file for the same OID.$
+	The file is mapped into memory and stays mapped, the names aren't
+	copied.
+
+Return value
+	The function returns the number of names loaded or -1 if the file
+	can't be read or has a syntax error.
+
+See also
+	oidBuild
+	oidLookup
+
+**************************************************************************<:*/
+
+int oidLoadFile (const char *fn) {
+	static MappedFile	 mf;
+	const char			*p,
+						*end,
+						*oid,
+						*name;
+	byte				 buffer[256];
+	int					 oidlen,
+						 namelen,
+						 len,
+						 count;
+	long				 line;
+
+	if (mapOpen (&mf, fn) == -1)
+		return -1;
+	if (!arenaready) {
+		arenaInit (&arena, 64 * 1024);
+		arenaready= 1;
+	}
+
+	p= (const char *)mf.data;
+	end= p + mf.length;
+	count= 0;
+	for (line= 1; p < end; line++) {
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+		oid= p;
+		while (p < end && (isdigit ((byte)*p) || *p == '.'))
+			p++;
+		oidlen= (int)(p - oid);
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+		name= p;
+		while (p < end && *p != '\n' && *p != '\r')
+			p++;
+		namelen= (int)(p - name);
+		while (namelen > 0 && isspace ((byte)name[namelen - 1]))
+			namelen--;
+		if (p < end && *p == '\r')
+			p++;
+		if (p < end && *p == '\n')
+			p++;
+
+		if (oidlen == 0 && (namelen == 0 || *name == '#'))
+			continue;				/* empty line or comment */
+		if (namelen == 0 || (len= oidEncode (oid, oidlen, buffer, sizeof(buffer))) == -1) {
+			fprintf (stderr, "%s: line %ld: syntax error\n", fn, line);
+			return -1;
+		}
+		if (AddName (buffer, len, name, namelen, nnames) == -1)
+			return -1;
+		count++;
+	}
+	return count;
+}
+
+
+/*:>* oidname.c *************************************************************
+
+Name
+	oidBuild
+
+Info
+	Build the lookup table for OID names
+
+Syntax
+	int oidBuild (void);
+
+Include
+	oidname.h
+
+Description
+	`oidBuild()` builds a perfect hash over the encoded OIDs of the
+	built-in names and all names loaded with `oidLoadFile()`. It must be
+	called after the last mapping file was loaded and before the first
+	call to `oidLookup()`.$
+	The keys are distributed into buckets of about four keys. For each
+	bucket, in the order of decreasing size, a displacement is searched
+	which moves all its keys into free slots. A lookup then costs two
+	hashes of the OID octets and one compare.
+
+Return value
+	The function returns 0 on success or -1 if no memory is available.
+
+See also
+	oidLookup
+
+**************************************************************************<:*/
+
+int oidBuild (void) {
+	long	 i,
+			 n;
+
+	if (nslots > 0)						/* already built */
+		return 0;
+	if (!arenaready) {
+		arenaInit (&arena, 64 * 1024);
+		arenaready= 1;
+	}
+	for (i= 0; i < NBUILTIN; i++)		/* files take precedence */
+		if (AddName (builtin[i].oid, builtin[i].oidlen, builtin[i].name, 
+					 (int)strlen (builtin[i].name), i - NBUILTIN) == -1)
+			return -1;
+
+	/* remove duplicates, the name defined last wins */
+	qsort (names, (size_t)nnames, sizeof(OidName), Compare);
+	for (i= 0, n= 0; i < nnames; i++) {
+		if (n > 0 && names[n - 1].oidlen == names[i].oidlen && 
+			memcmp (names[n - 1].oid, names[i].oid, names[i].oidlen) == 0)
+			n--;
+		names[n++]= names[i];
+	}
+	nnames= n;
+
+	for (n= nnames + nnames / 4 + 1; ; n+= n / 8 + 1)
+		switch (TryBuild (n, nnames / 4 + 1)) {
+			case 0:		return 0;
+			case -1:	return -1;
+		}
+}
+
+
+/*:>* oidname.c *************************************************************
+
+Name
+	oidLookup
+
+Info
+	Find the name of an OID
+
+Syntax
+	const char *oidLookup (const byte *content, long length, int *namelen);
+
+Include
+	oidname.h
+
+Description
+	`oidLookup()` looks up the name of the OID with the encoded `content`
+	of `length` octets. The length of the name is stored in `namelen`.
+
+Return value
+	The function returns a pointer to the name, which isn't terminated, or
+	NULL if the OID has no name.
+
+See also
+	oidBuild
+
+**************************************************************************<:*/
+
+const char *oidLookup (const byte *content, long length, int *namelen) {
+	OidName	*n;
+	long	 slot;
+
+	if (nslots == 0)
+		return NULL;
+	slot= slots[Hash (content, length, disp[Hash (content, length, 0) % nbuckets]) % nslots];
+	if (slot == -1)
+		return NULL;
+	n= &names[slot];
+	if (n->oidlen != length || memcmp (n->oid, content, (size_t)length) != 0)
+		return NULL;
+	*namelen= n->namelen;
+	return n->name;
+}
+
+
+/*:>* oidname.c *************************************************************
+
+Name
+	oidEncode
+
+Info
+	Encode a dotted OID
+
+Syntax
+	int oidEncode (const char *oid, int length, byte *buffer, int size);
+
+Include
+	oidname.h
+
+Description
+	`oidEncode()` converts the `length` characters of the dotted OID `oid`
+	into the content octets of its BER encoding in `buffer`, which can hold
+	`size` octets. Arcs too big for an `unsigned long` are converted digit
+	by digit.
+
+Return value
+	The function returns the number of octets or -1 if `oid` is malformed
+	or the encoding doesn't fit into `buffer`.
+
+**************************************************************************<:*/
+
+int oidEncode (const char *oid, int length, byte *buffer, int size) {
+	unsigned long	 v,
+					 first;
+	int				 i,
+					 n,
+					 k,
+					 arcs,
+					 start,
+					 big;
+	byte			 tmp[sizeof(unsigned long) * 8 / 7 + 1];
+
+	n= 0;
+	first= 0;
+	for (i= 0, arcs= 0; i < length; arcs++) {
+		if (!isdigit ((byte)oid[i]))
+			return -1;
+		for (v= 0, big= 0, start= i; i < length && isdigit ((byte)oid[i]); i++) {
+			if (v > (~0UL - 9) / 10)
+				big= 1;					/* the next digit doesn't fit */
+			v= v * 10 + (unsigned long)(oid[i] - '0');
+		}
+		k= i - start;
+		if (i < length && (oid[i++] != '.' || i == length))
+			return -1;
+
+		if (arcs == 0) {				/* first two arcs form one subidentifier */
+			if (v > 2 || big)
+				return -1;
+			first= v;
+			continue;
+		}
+		if (arcs == 1) {
+			if (first < 2 && (v > 39 || big))
+				return -1;
+			if (v > ~0UL - first * 40)
+				big= 1;
+			else if (!big)
+				v+= first * 40;
+		}
+		if (big) {
+			if ((k= BigArc (oid + start, k, arcs == 1 ? first * 40 : 0, buffer + n, size - n)) == -1)
+				return -1;
+			n+= k;
+			continue;
+		}
+		k= 0;
+		do {
+			tmp[k++]= (byte)(v & 0x7f);
+			v>>= 7;
+		} while (v);
+		if (n + k > size)
+			return -1;
+		while (k > 0) {
+			k--;
+			buffer[n++]= (byte)(tmp[k] | (k ? 0x80 : 0));
+		}
+	}
+	return (arcs < 2) ? -1 : n;
+}
+
+
+/****************************************************************************/
+
+static int AddName (const byte *oid, int oidlen, const char *name, int namelen, long seq) {
+	OidName	*tmp;
+	byte	*copy;
+	long	 n;
+
+	if (nnames >= sizenames) {
+		n= (sizenames > 0) ? sizenames * 2 : 256;
+		if ((tmp= realloc (names, n * sizeof(OidName))) == NULL)
+			return -1;
+		names= tmp;
+		sizenames= n;
+	}
+	if (seq >= 0) {						/* from a file, keep a copy */
+		if ((copy= arenaAlloc (&arena, (size_t)oidlen)) == NULL)
+			return -1;
+		memcpy (copy, oid, (size_t)oidlen);
+		oid= copy;
+	}
+	names[nnames].oid= oid;
+	names[nnames].oidlen= oidlen;
+	names[nnames].name= name;
+	names[nnames].namelen= namelen;
+	names[nnames].seq= seq;
+	nnames++;
+	return 0;
+}
+
+
+/*
+ * Sort by OID and then by the order of definition
+ */
+
+/*
+ * encode the decimal arc in the count digits at p plus add into buffer,
+ * return the number of octets or -1 if they don't fit into size
+ */
+
+static int BigArc (const char *p, int count, unsigned long add, byte *buffer, int size) {
+	unsigned long	 d;
+	int				 i,
+					 k,
+					 n;
+	byte			 c;
+
+	/* the 7 bit groups, lowest first: multiply by 10 and add each digit */
+	for (n= 0, i= 0; i <= count; i++) {
+		d= (i < count) ? (unsigned long)(p[i] - '0') : add;
+		for (k= 0; k < n; k++) {
+			d+= (i < count) ? buffer[k] * 10UL : buffer[k];
+			buffer[k]= (byte)(d & 0x7f);
+			d>>= 7;
+		}
+		for (; d != 0; d>>= 7) {
+			if (n >= size)
+				return -1;
+			buffer[n++]= (byte)(d & 0x7f);
+		}
+	}
+	for (k= 0; k < n / 2; k++) {
+		c= buffer[k];
+		buffer[k]= buffer[n - 1 - k];
+		buffer[n - 1 - k]= c;
+	}
+	for (k= 0; k < n - 1; k++)
+		buffer[k]|= 0x80;
+	return n;
+}
+
+static int Compare (const void *p1, const void *p2) {
+	const OidName	*n1= p1,
+					*n2= p2;
+	int				 c;
+
+	if (n1->oidlen != n2->oidlen)
+		return n1->oidlen - n2->oidlen;
+	if ((c= memcmp (n1->oid, n2->oid, (size_t)n1->oidlen)) != 0)
+		return c;
+	return (n1->seq < n2->seq) ? -1 : (n1->seq > n2->seq);
+}
+
+
+/*
+ * FNV-1a over the octets, started from a seed
+ */
+
+static unsigned long Hash (const byte *p, long length, unsigned long seed) {
+	unsigned long	 h;
+
+	h= (2166136261UL ^ (seed * 0x9e3779b9UL)) & 0xffffffffUL;
+	while (length-- > 0) {
+		h^= *p++;
+		h= (h * 16777619UL) & 0xffffffffUL;
+	}
+	return h;
+}
+
+
+/*
+ * Try to find a perfect hash with n slots and nb buckets. Returns 0 on
+ * success, 1 if it didn't work out and -1 if there is no memory.
+ */
+
+# define	MAXDISP		100000
+
+static int TryBuild (long n, long nb) {
+	long	*start,			/* first member of each bucket		*/
+			*members,		/* names, grouped by bucket			*/
+			*fill,
+			 i,
+			 j,
+			 k,
+			 b,
+			 sz,
+			 maxsize;
+	unsigned long	 d;
+	int		 rc;
+
+	free (slots);
+	free (disp);
+	slots= malloc (n * sizeof(long));
+	disp= malloc (nb * sizeof(unsigned long));
+	start= calloc ((size_t)nb + 1, sizeof(long));
+	fill= calloc ((size_t)nb, sizeof(long));
+	members= malloc ((nnames + 1) * sizeof(long));
+	if (!slots || !disp || !start || !fill || !members) {
+		free (start);
+		free (fill);
+		free (members);
+		return -1;
+	}
+	nslots= n;
+	nbuckets= nb;
+	for (i= 0; i < n; i++)
+		slots[i]= -1;
+	for (b= 0; b < nb; b++)
+		disp[b]= 0;
+
+	/* group the names by bucket */
+	for (i= 0; i < nnames; i++)
+		start[Hash (names[i].oid, names[i].oidlen, 0) % nb + 1]++;
+	for (b= 0, maxsize= 0; b < nb; b++) {
+		if (start[b + 1] > maxsize)
+			maxsize= start[b + 1];
+		start[b + 1]+= start[b];
+	}
+	for (i= 0; i < nnames; i++) {
+		b= (long)(Hash (names[i].oid, names[i].oidlen, 0) % nb);
+		members[start[b] + fill[b]++]= i;
+	}
+
+	/* place the largest buckets first */
+	rc= 0;
+	for (sz= maxsize; sz > 0 && rc == 0; sz--)
+		for (b= 0; b < nb && rc == 0; b++) {
+			if (start[b + 1] - start[b] != sz)
+				continue;
+			for (d= 1; d < MAXDISP; d++) {
+				for (k= start[b]; k < start[b + 1]; k++) {
+					i= members[k];
+					j= (long)(Hash (names[i].oid, names[i].oidlen, d) % n);
+					if (slots[j] != -1)
+						break;
+					slots[j]= i;
+				}
+				if (k == start[b + 1])
+					break;
+				while (--k >= start[b]) {		/* undo */
+					i= members[k];
+					slots[Hash (names[i].oid, names[i].oidlen, d) % n]= -1;
+				}
+			}
+			if (d == MAXDISP)
+				rc= 1;
+			disp[b]= d;
+		}
+
+	free (start);
+	free (fill);
+	free (members);
+	if (rc != 0)
+		nslots= 0;
+	return rc;
+}
@@ -0,0 +1,18 @@
+/*
+ *	oidname.h
+ *
+ *	Includefile for oidname.c
+ */
+
+#ifndef __OIDNAME_H__
+#define __OIDNAME_H__
+
+#include "vlARGS.h"
+#include "berhdr.h"
+
+EXTERN int			 oidLoadFile (const char *);
+EXTERN int			 oidBuild (void);
+EXTERN const char	*oidLookup (const byte *, long, int *);
+EXTERN int			 oidEncode (const char *, int, byte *, int);
+
+#endif
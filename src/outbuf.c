@@ -0,0 +1,171 @@
+/*
+ *	outbuf.c
+ *
+ *	Collect formatted output in memory, so that it can be produced by
+ *	several threads and written in order.
+ */
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	<stdarg.h>
+# include	<string.h>
+# include	"outbuf.h"
+
+
+static int	 Grow (OutBuf *, long);
+
+
+/*:>* outbuf.c **************************************************************
+
+Name
+	obPrintf
+
+Info
+	Formatted output into a buffer
+
+Syntax
+	void obInit (OutBuf *buf);
+	int obPrintf (OutBuf *buf, const char *format, ...);
+	int obWrite (OutBuf *buf, const char *data, long length);
+	int obLong (OutBuf *buf, long value, int width);
+	int obHex (OutBuf *buf, unsigned long value, int width);
+	int obFlush (OutBuf *buf, FILE *fp);
+	void obFree (OutBuf *buf);
+
+Include
+	outbuf.h
+
+Description
+	`obPrintf()` works like printf(), but appends the output to `buf`,
+	which grows as needed. `obWrite()` appends `length` bytes of `data`
+	unformatted. `obLong()` appends `value` in decimal, padded with zeros
+	to `width` characters like "%0*ld", without parsing a format, `obHex()`
+	appends it in upper case hex like "%0*lX". `obFlush()` writes the
+	content of `buf` to `fp` and empties it, the memory is kept for
+	further output. `obInit()` prepares an empty buffer, `obFree()`
+	releases its memory.$
+	When the buffer can't grow, `failed` of the buffer is set and stays
+	set until the caller clears it, so the output can be checked once
+	after a number of calls.
+
+Return value
+	`obPrintf()` returns the number of characters appended or -1 if there
+	isn't enough memory, `obWrite()`, `obLong()` and `obHex()` return 0
+	or -1. `obFlush()` returns 0 or EOF on a write error.
+
+Example
+	% OutBuf	 out;
+	%
+	% obInit (&out);
+	% obPrintf (&out, "::= %ld\n", value);
+	% obFlush (&out, stdout);
+
+**************************************************************************<:*/
+
+void obInit (OutBuf *buf) {
+	buf->data= NULL;
+	buf->length= 0;
+	buf->size= 0;
+	buf->failed= 0;
+}
+
+int obPrintf (OutBuf *buf, const char *format, ...) {
+	va_list	 ap;
+	int		 n;
+
+	if (buf->size - buf->length < 256 && Grow (buf, 256) == -1)
+		return -1;
+	va_start (ap, format);
+	n= vsnprintf (buf->data + buf->length, (size_t)(buf->size - buf->length), format, ap);
+	va_end (ap);
+	if (n < 0)
+		return -1;
+	if (n >= buf->size - buf->length) {		/* didn't fit, try again */
+		if (Grow (buf, n + 1) == -1)
+			return -1;
+		va_start (ap, format);
+		n= vsnprintf (buf->data + buf->length, (size_t)(buf->size - buf->length), format, ap);
+		va_end (ap);
+	}
+	buf->length+= n;
+	return n;
+}
+
+int obWrite (OutBuf *buf, const char *data, long length) {
+	if (buf->size - buf->length < length && Grow (buf, length) == -1)
+		return -1;
+	memcpy (buf->data + buf->length, data, (size_t)length);
+	buf->length+= length;
+	return 0;
+}
+
+int obLong (OutBuf *buf, long value, int width) {
+	char			 digits[24],
+					*p;
+	unsigned long	 u;
+	int				 negative;
+
+	negative= value < 0;
+	u= negative ? 0UL - (unsigned long)value : (unsigned long)value;
+	p= digits + sizeof(digits);
+	do {
+		*--p= (char)('0' + u % 10);
+		u/= 10;
+	} while (u != 0);
+	while (digits + sizeof(digits) - p < width - negative && p > digits + 1)
+		*--p= '0';
+	if (negative)
+		*--p= '-';
+	return obWrite (buf, p, (long)(digits + sizeof(digits) - p));
+}
+
+int obHex (OutBuf *buf, unsigned long value, int width) {
+	char	 digits[24],
+			*p;
+
+	p= digits + sizeof(digits);
+	do {
+		*--p= "0123456789ABCDEF"[value & 15];
+		value>>= 4;
+	} while (value != 0);
+	while (digits + sizeof(digits) - p < width && p > digits)
+		*--p= '0';
+	return obWrite (buf, p, (long)(digits + sizeof(digits) - p));
+}
+
+int obFlush (OutBuf *buf, FILE *fp) {
+	size_t	 n;
+
+	n= buf->length > 0 ? fwrite (buf->data, 1, (size_t)buf->length, fp) : 0;
+	if ((long)n != buf->length)
+		return EOF;
+	buf->length= 0;
+	return 0;
+}
+
+void obFree (OutBuf *buf) {
+	free (buf->data);
+	obInit (buf);
+}
+
+
+/*
+ * make room for at least n more bytes
+ */
+
+static int Grow (OutBuf *buf, long n) {
+	char	*data;
+	long	 size;
+
+	if (buf->failed)
+		return -1;					/* don't try again and again */
+	for (size= buf->size ? buf->size : 65536; size - buf->length < n; size*= 2)
+		;
+	if ((data= realloc (buf->data, (size_t)size)) == NULL) {
+		buf->failed= 1;
+		return -1;
+	}
+	buf->data= data;
+	buf->size= size;
+	return 0;
+}
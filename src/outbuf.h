@@ -0,0 +1,31 @@
+/*
+ *	outbuf.h
+ *
+ *	Includefile for outbuf.c
+ */
+
+#ifndef __OUTBUF_H__
+#define __OUTBUF_H__
+
+#include <stdio.h>
+#include "vlARGS.h"
+
+/*
+ *	Growing buffer for formatted output
+ */
+typedef struct {
+	char		*data;
+	long		 length;		/* bytes in data						*/
+	long		 size;			/* allocated bytes						*/
+	int			 failed;		/* output was lost for lack of memory	*/
+} OutBuf;
+
+EXTERN void		 obInit (OutBuf *);
+EXTERN int		 obPrintf (OutBuf *, const char *, ...);
+EXTERN int		 obWrite (OutBuf *, const char *, long);
+EXTERN int		 obLong (OutBuf *, long, int);
+EXTERN int		 obHex (OutBuf *, unsigned long, int);
+EXTERN int		 obFlush (OutBuf *, FILE *);
+EXTERN void		 obFree (OutBuf *);
+
+#endif
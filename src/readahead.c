@@ -0,0 +1,459 @@
+/*
+ *	readahead.c
+ *
+ *	Keep several large reads of a file in flight ahead of a cursor, so
+ *	that the pages are in the page cache when the mapped file is decoded
+ *	there. The reads are done with io_uring where the kernel has it, and
+ *	by a pool of threads otherwise.
+ */
+
+# if defined(__linux__)
+# define	_GNU_SOURCE
+# endif
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	<string.h>
+# include	"readahead.h"
+
+# if defined(__GNUC__) && (defined(__unix__) || defined(__APPLE__)) && !defined(NO_THREADS)
+# define	HAS_THREADS
+# include	<pthread.h>
+# include	<unistd.h>
+# endif
+
+# if defined(__linux__) && !defined(NO_URING)
+# include	<sys/syscall.h>
+# include	<sys/mman.h>
+# include	<sys/uio.h>
+# include	<unistd.h>
+# include	<errno.h>
+# if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+# define	HAS_URING
+# include	<linux/io_uring.h>
+# endif
+# endif
+
+# define	MAXDEPTH		256			/* at most this many reads in flight	*/
+# define	BLOCKSIZE		(1L << 20)	/* default bytes per read				*/
+
+struct RaEngine {
+	char			**buffer;		/* one buffer per read in flight		*/
+	int				 *freeslot;		/* buffers not in use					*/
+	int				  nfree;
+	long			  inflight;
+# ifdef HAS_URING
+	int				  ring;
+	struct iovec	 *iov;
+	void			 *sqmap,
+					 *cqmap;
+	size_t			  sqsize,
+					  cqsize,
+					  sqesize;
+	unsigned		 *sqtail,
+					 *sqmask,
+					 *sqarray,
+					 *cqhead,
+					 *cqtail,
+					 *cqmask;
+	struct io_uring_sqe	*sqes;
+	struct io_uring_cqe	*cqes;
+# endif
+# ifdef HAS_THREADS
+	pthread_t		 *tid;
+	int				  threads;
+	pthread_mutex_t	  lock;			/* for next, limit, reads and bytes		*/
+	pthread_cond_t	  wake;
+	long			  limit;		/* read the blocks up to here			*/
+	int				  stopping;
+# endif
+};
+
+# ifdef HAS_THREADS
+typedef struct {
+	Readahead	*ra;
+	char		*buffer;
+} ReadArg;
+# endif
+
+static int		 ThreadsStart (Readahead *);
+static void		 ThreadsFill (Readahead *, long, long);
+static void		 ThreadsStop (Readahead *);
+static int		 UringStart (Readahead *);
+static void		 UringFill (Readahead *, long, long);
+# ifdef HAS_URING
+static void		 UringReap (Readahead *);
+# endif
+static void		 UringStop (Readahead *);
+
+
+/*:>* readahead.c ***********************************************************
+
+Name
+	raStart
+
+Info
+	Start reading a file ahead of a cursor
+
+Syntax
+	int raStart (Readahead *ra, int fd, long length, int depth, long blocksize);
+	void raAdvance (Readahead *ra, long pos);
+	void raStop (Readahead *ra);
+	const char *raMethod (Readahead *ra);
+
+Include
+	readahead.h
+
+Description
+	`raStart()` prepares to read the file `fd` of `length` bytes in blocks
+	of `blocksize` bytes (0 for 1 MB), with up to `depth` reads in flight.
+	Nothing is read until `raAdvance()` is called.$
+	`raAdvance()` tells the position `pos` up to which the file has been
+	processed. Reads are started for the blocks of the next `depth *
+	blocksize` bytes which aren't read yet, blocks behind `pos` are
+	skipped. The call returns immediately, it is cheap enough to be made
+	for every element: the reads are only looked at again once `pos` has
+	moved on by a block.$
+	The data read is thrown away, the reads only bring the file into the
+	page cache, so that a mapping of the file is decoded without waiting
+	for the disk. With io_uring the reads are submitted from the calling
+	thread, otherwise `depth` threads read the blocks with pread().$
+	`raStop()` waits for the reads in flight and releases everything.
+	`raMethod()` names the method used, for statistics.
+
+Return value
+	`raStart()` returns 0 or -1 if neither io_uring nor threads are
+	available or there isn't enough memory. `ra->method` is `raOFF` then,
+	and `raAdvance()` does nothing.
+
+Example
+	% raStart (&ra, mf.fd, mf.length, 8, 0);
+	% for (pos= 0; pos < mf.length; pos= next) {
+	%	raAdvance (&ra, pos);
+	%	next= Decode (mf.data, pos);
+	% }
+	% raStop (&ra);
+
+**************************************************************************<:*/
+
+int raStart (Readahead *ra, int fd, long length, int depth, long blocksize) {
+	RaEngine	*e;
+	int			 i;
+
+	memset (ra, 0, sizeof(Readahead));
+	ra->method= raOFF;
+	if (depth <= 0)
+		return -1;
+	ra->fd= fd;
+	ra->length= length;
+	ra->depth= depth < MAXDEPTH ? depth : MAXDEPTH;
+	ra->blocksize= blocksize > 0 ? blocksize : BLOCKSIZE;
+
+	if ((e= ra->engine= calloc (1, sizeof(RaEngine))) == NULL)
+		return -1;
+	e->buffer= calloc ((size_t)ra->depth, sizeof(char *));
+	e->freeslot= malloc (ra->depth * sizeof(int));
+	if (e->buffer == NULL || e->freeslot == NULL) {
+		raStop (ra);
+		return -1;
+	}
+	for (i= 0; i < ra->depth; i++) {
+		if ((e->buffer[i]= malloc ((size_t)ra->blocksize)) == NULL) {
+			raStop (ra);
+			return -1;
+		}
+		e->freeslot[e->nfree++]= i;
+	}
+
+	if (UringStart (ra) == 0)
+		ra->method= raURING;
+	else if (ThreadsStart (ra) == 0)
+		ra->method= raTHREADS;
+	else {
+		raStop (ra);
+		return -1;
+	}
+	return 0;
+}
+
+void raAdvance (Readahead *ra, long pos) {
+	if (ra->method == raOFF || pos < ra->check)
+		return;
+	ra->check= pos + ra->blocksize;
+	if (ra->method == raURING)
+		UringFill (ra, pos, pos + ra->depth * ra->blocksize);
+	else
+		ThreadsFill (ra, pos, pos + ra->depth * ra->blocksize);
+}
+
+void raStop (Readahead *ra) {
+	RaEngine	*e;
+	int			 i;
+
+	if ((e= ra->engine) == NULL)
+		return;
+	if (ra->method == raURING)
+		UringStop (ra);
+	else if (ra->method == raTHREADS)
+		ThreadsStop (ra);
+	if (e->buffer != NULL)
+		for (i= 0; i < ra->depth; i++)
+			free (e->buffer[i]);
+	free (e->buffer);
+	free (e->freeslot);
+	free (e);
+	ra->engine= NULL;
+	ra->method= raOFF;
+}
+
+const char *raMethod (Readahead *ra) {
+	switch (ra->method) {
+		case raURING:	return "io_uring";
+		case raTHREADS:	return "threads";
+		default:		return "off";
+	}
+}
+
+
+/****************************************************************************/
+
+/*
+ * io_uring, used through the system calls so that no library is needed.
+ * Only the calling thread touches the rings.
+ */
+
+# ifdef HAS_URING
+
+static int UringStart (Readahead *ra) {
+	RaEngine				*e= ra->engine;
+	struct io_uring_params	 p;
+	int						 i;
+
+	if ((e->iov= malloc (ra->depth * sizeof(struct iovec))) == NULL)
+		return -1;
+	for (i= 0; i < ra->depth; i++) {
+		e->iov[i].iov_base= e->buffer[i];
+		e->iov[i].iov_len= (size_t)ra->blocksize;
+	}
+
+	memset (&p, 0, sizeof(p));
+	if ((e->ring= (int)syscall (__NR_io_uring_setup, (unsigned)ra->depth, &p)) < 0) {
+		free (e->iov);
+		e->iov= NULL;
+		return -1;
+	}
+	e->sqsize= p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	e->cqsize= p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	e->sqesize= p.sq_entries * sizeof(struct io_uring_sqe);
+	e->sqmap= mmap (NULL, e->sqsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, e->ring, IORING_OFF_SQ_RING);
+	e->cqmap= mmap (NULL, e->cqsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, e->ring, IORING_OFF_CQ_RING);
+	e->sqes= mmap (NULL, e->sqesize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, e->ring, IORING_OFF_SQES);
+	if (e->sqmap == MAP_FAILED || e->cqmap == MAP_FAILED || e->sqes == MAP_FAILED) {
+		UringStop (ra);
+		return -1;
+	}
+	e->sqtail= (unsigned *)((char *)e->sqmap + p.sq_off.tail);
+	e->sqmask= (unsigned *)((char *)e->sqmap + p.sq_off.ring_mask);
+	e->sqarray= (unsigned *)((char *)e->sqmap + p.sq_off.array);
+	e->cqhead= (unsigned *)((char *)e->cqmap + p.cq_off.head);
+	e->cqtail= (unsigned *)((char *)e->cqmap + p.cq_off.tail);
+	e->cqmask= (unsigned *)((char *)e->cqmap + p.cq_off.ring_mask);
+	e->cqes= (struct io_uring_cqe *)((char *)e->cqmap + p.cq_off.cqes);
+	return 0;
+}
+
+static void UringFill (Readahead *ra, long pos, long end) {
+	RaEngine			*e= ra->engine;
+	struct io_uring_sqe	*sqe;
+	unsigned			 tail;
+	int					 slot,
+						 n;
+	long				 submitted;
+
+	UringReap (ra);
+	if (ra->next < pos)
+		ra->next= pos - pos % ra->blocksize;
+	for (n= 0; e->nfree > 0 && ra->next < end && ra->next < ra->length; n++) {
+		slot= e->freeslot[--e->nfree];
+		tail= *e->sqtail;
+		sqe= &e->sqes[tail & *e->sqmask];
+		memset (sqe, 0, sizeof(struct io_uring_sqe));
+		sqe->opcode= IORING_OP_READV;
+		sqe->fd= ra->fd;
+		sqe->off= (unsigned long long)ra->next;
+		sqe->addr= (unsigned long long)(unsigned long)&e->iov[slot];
+		sqe->len= 1;
+		sqe->user_data= (unsigned long long)slot;
+		e->sqarray[tail & *e->sqmask]= tail & *e->sqmask;
+		__atomic_store_n (e->sqtail, tail + 1, __ATOMIC_RELEASE);
+		ra->next+= ra->blocksize;
+	}
+	if (n == 0)
+		return;
+	submitted= syscall (__NR_io_uring_enter, e->ring, (unsigned)n, 0, 0, NULL, 0);
+	if (submitted < 0) {		/* the kernel refuses, give up */
+		UringStop (ra);
+		ra->method= raOFF;
+		return;
+	}
+	e->inflight+= submitted;
+}
+
+static void UringReap (Readahead *ra) {
+	RaEngine			*e= ra->engine;
+	struct io_uring_cqe	*cqe;
+	unsigned			 head,
+						 tail;
+
+	head= *e->cqhead;
+	tail= __atomic_load_n (e->cqtail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++) {
+		cqe= &e->cqes[head & *e->cqmask];
+		e->freeslot[e->nfree++]= (int)cqe->user_data;
+		e->inflight--;
+		ra->reads++;
+		if (cqe->res > 0)
+			ra->bytes+= cqe->res;
+	}
+	__atomic_store_n (e->cqhead, head, __ATOMIC_RELEASE);
+}
+
+static void UringStop (Readahead *ra) {
+	RaEngine	*e= ra->engine;
+
+	while (e->cqhead != NULL && e->inflight > 0) {
+		if (syscall (__NR_io_uring_enter, e->ring, 0, (unsigned)e->inflight, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+			break;
+		UringReap (ra);
+	}
+	if (e->inflight > 0) {		/* the kernel may still use them */
+		e->buffer= NULL;
+		e->iov= NULL;
+	}
+	if (e->sqmap != NULL && e->sqmap != MAP_FAILED)
+		munmap (e->sqmap, e->sqsize);
+	if (e->cqmap != NULL && e->cqmap != MAP_FAILED)
+		munmap (e->cqmap, e->cqsize);
+	if (e->sqes != NULL && (void *)e->sqes != MAP_FAILED)
+		munmap (e->sqes, e->sqesize);
+	close (e->ring);
+	free (e->iov);
+	e->iov= NULL;
+}
+
+# else
+
+static int UringStart (Readahead *ra) {
+	return -1;
+}
+
+static void UringFill (Readahead *ra, long pos, long end) {
+}
+
+static void UringStop (Readahead *ra) {
+}
+
+# endif
+
+
+/****************************************************************************/
+
+/*
+ * A pool of threads, each reads one block at a time into its own buffer
+ */
+
+# ifdef HAS_THREADS
+
+static void *ReadBlocks (void *arg) {
+	Readahead	*ra= ((ReadArg *)arg)->ra;
+	char		*buffer= ((ReadArg *)arg)->buffer;
+	RaEngine	*e= ra->engine;
+	long		 pos,
+				 n;
+
+	pthread_mutex_lock (&e->lock);
+	for (;;) {
+		while (!e->stopping && (ra->next >= e->limit || ra->next >= ra->length))
+			pthread_cond_wait (&e->wake, &e->lock);
+		if (e->stopping)
+			break;
+		pos= ra->next;
+		ra->next+= ra->blocksize;
+		pthread_mutex_unlock (&e->lock);
+		n= (long)pread (ra->fd, buffer, (size_t)ra->blocksize, (off_t)pos);
+		pthread_mutex_lock (&e->lock);
+		ra->reads++;
+		if (n > 0)
+			ra->bytes+= n;
+	}
+	pthread_mutex_unlock (&e->lock);
+	free (arg);
+	return NULL;
+}
+
+static int ThreadsStart (Readahead *ra) {
+	RaEngine	*e= ra->engine;
+	ReadArg		*arg;
+
+	if ((e->tid= malloc (ra->depth * sizeof(pthread_t))) == NULL)
+		return -1;
+	pthread_mutex_init (&e->lock, NULL);
+	pthread_cond_init (&e->wake, NULL);
+	for (e->threads= 0; e->threads < ra->depth; e->threads++) {
+		if ((arg= malloc (sizeof(ReadArg))) == NULL)
+			break;
+		arg->ra= ra;
+		arg->buffer= e->buffer[e->threads];
+		if (pthread_create (&e->tid[e->threads], NULL, ReadBlocks, arg) != 0) {
+			free (arg);
+			break;
+		}
+	}
+	if (e->threads == 0) {
+		ThreadsStop (ra);
+		return -1;
+	}
+	return 0;
+}
+
+static void ThreadsFill (Readahead *ra, long pos, long end) {
+	RaEngine	*e= ra->engine;
+
+	pthread_mutex_lock (&e->lock);
+	if (ra->next < pos)
+		ra->next= pos - pos % ra->blocksize;
+	if (end > e->limit) {
+		e->limit= end;
+		pthread_cond_broadcast (&e->wake);
+	}
+	pthread_mutex_unlock (&e->lock);
+}
+
+static void ThreadsStop (Readahead *ra) {
+	RaEngine	*e= ra->engine;
+	int			 i;
+
+	pthread_mutex_lock (&e->lock);
+	e->stopping= 1;
+	pthread_cond_broadcast (&e->wake);
+	pthread_mutex_unlock (&e->lock);
+	for (i= 0; i < e->threads; i++)
+		pthread_join (e->tid[i], NULL);
+	pthread_mutex_destroy (&e->lock);
+	pthread_cond_destroy (&e->wake);
+	free (e->tid);
+}
+
+# else
+
+static int ThreadsStart (Readahead *ra) {
+	return -1;
+}
+
+static void ThreadsFill (Readahead *ra, long pos, long end) {
+}
+
+static void ThreadsStop (Readahead *ra) {
+}
+
+# endif
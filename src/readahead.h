@@ -0,0 +1,40 @@
+/*
+ *	readahead.h
+ *
+ *	Includefile for readahead.c
+ */
+
+#ifndef __READAHEAD_H__
+#define __READAHEAD_H__
+
+#include "vlARGS.h"
+
+/* How the reads are done */
+# define	raOFF			0		/* no read-ahead						*/
+# define	raURING			1		/* io_uring								*/
+# define	raTHREADS		2		/* pool of threads with pread()			*/
+
+typedef struct RaEngine RaEngine;
+
+/*
+ *	Read-ahead in front of a cursor
+ */
+typedef struct {
+	int			 method;		/* raOFF, raURING or raTHREADS			*/
+	int			 fd;
+	long		 length;		/* length of the file					*/
+	int			 depth;			/* reads in flight						*/
+	long		 blocksize;		/* bytes per read						*/
+	long		 next;			/* next block to read					*/
+	long		 check;			/* cursor position for the next check	*/
+	long		 reads;			/* statistics							*/
+	long		 bytes;
+	RaEngine	*engine;
+} Readahead;
+
+EXTERN int		 raStart (Readahead *, int, long, int, long);
+EXTERN void		 raAdvance (Readahead *, long);
+EXTERN void		 raStop (Readahead *);
+EXTERN const char *raMethod (Readahead *);
+
+#endif
@@ -0,0 +1,1084 @@
+/*
+ *	schema.c
+ *
+ *	Read ASN.1 modules and name the elements of a dump after the
+ *	components and types of the module.
+ *
+ *	The parser understands the part of ASN.1 which determines the tags
+ *	of a type: type assignments with SEQUENCE, SET, CHOICE, SEQUENCE OF,
+ *	SET OF, tagged types, the built-in types and type references, with
+ *	EXPLICIT, IMPLICIT or AUTOMATIC tagging. Constraints, named numbers,
+ *	value assignments, IMPORTS and EXPORTS are skipped. Assignments which
+ *	can't be parsed (e.g. information object classes) are skipped with a
+ *	warning.
+ *
+ *	After loading, the tags of all components are put into a hash table
+ *	with the key (type, class, tag). Finding the component of an element
+ *	is then a single lookup with the type of its parent.
+ */
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	<string.h>
+# include	<ctype.h>
+# include	"berhdr.h"
+# include	"mapfile.h"
+# include	"schema.h"
+
+/* Kinds of types */
+# define	stROOT			0		/* all assigned types, for top-level elements	*/
+# define	stSEQUENCE		1
+# define	stSET			2
+# define	stCHOICE		3
+# define	stSEQOF			4
+# define	stSETOF			5
+# define	stPRIM			6		/* built-in type, tag is the universal tag		*/
+# define	stREF			7		/* type reference, inner is the target			*/
+# define	stTAGGED		8		/* tagged type, inner is the type under the tag	*/
+# define	stANY			9
+
+# define	MAXDEPTH		32		/* of reference chains							*/
+
+typedef struct {
+	int			 kind;
+	const char	*name;				/* name of an assigned type or NULL		*/
+	int			 namelen;
+	const char	*ref;				/* stREF: the referenced name			*/
+	int			 reflen;
+	int			 cl;				/* stTAGGED: class and tag				*/
+	long		 tag;				/* stTAGGED, stPRIM: tag number			*/
+	int			 explicit;			/* stTAGGED: explicit tagging			*/
+	long		 inner;				/* see above, stSEQOF/stSETOF: element	*/
+	long		 first;				/* components							*/
+	long		 count;
+} SchemaType;
+
+typedef struct {
+	const char	*name;
+	int			 namelen;
+	long		 type;
+} SchemaComp;
+
+typedef struct {
+	long		 type;				/* -1: empty slot						*/
+	long		 tag;
+	int			 cl;
+	long		 comp;
+} SchemaKey;
+
+typedef struct {
+	const char	*p;
+	int			 len;
+	long		 line;
+} Token;
+
+static SchemaType	*types = NULL;
+static long			 ntypes = 0;
+static long			 sizetypes = 0;
+static SchemaComp	*comps = NULL;
+static long			 ncomps = 0;
+static long			 sizecomps = 0;
+static SchemaKey	*keys = NULL;
+static long			 nkeys = 0;
+static long			 sizekeys = 0;	/* power of 2								*/
+static long			*assigned = NULL;	/* assigned types, sorted by name		*/
+static long			 nassigned = 0;
+
+static Token		*tokens = NULL;
+static long			 ntokens = 0;
+static long			 tokensize = 0;
+static long			 tp = 0;		/* current token							*/
+static int			 tagdefault;	/* 0: EXPLICIT, 1: IMPLICIT, 2: AUTOMATIC	*/
+static const char	*fname;
+
+
+/*
+ *	Names of the built-in types
+ */
+static struct {
+	const char	*name;
+	const char	*second;			/* second word or NULL					*/
+	int			 utag;
+} builtins[]= {
+	{ "BOOLEAN",			NULL,			berBOOLEAN },
+	{ "INTEGER",			NULL,			berINTEGER },
+	{ "BIT",				"STRING",		berBITSTRING },
+	{ "OCTET",				"STRING",		berOCTETSTRING },
+	{ "NULL",				NULL,			berNULL },
+	{ "OBJECT",				"IDENTIFIER",	berOBJECTID },
+	{ "ObjectDescriptor",	NULL,			berOBJDESCRIPTOR },
+	{ "EXTERNAL",			NULL,			berEXTERNAL },
+	{ "REAL",				NULL,			berREAL },
+	{ "ENUMERATED",			NULL,			berENUMERATED },
+	{ "UTF8String",			NULL,			berUTF8STRING },
+	{ "RELATIVE-OID",		NULL,			13 },
+	{ "NumericString",		NULL,			berNUMERICSTRING },
+	{ "PrintableString",	NULL,			berPRINTABLESTRING },
+	{ "TeletexString",		NULL,			berTELETEXSTRING },
+	{ "T61String",			NULL,			berTELETEXSTRING },
+	{ "VideotexString",		NULL,			berVIDEOTEXSTRING },
+	{ "IA5String",			NULL,			berIA5STRING },
+	{ "UTCTime",			NULL,			berUTCTIME },
+	{ "GeneralizedTime",	NULL,			berGENERALIZEDTIME },
+	{ "GraphicString",		NULL,			berGRAPHICSTRING },
+	{ "VisibleString",		NULL,			berVISIBLESTRING },
+	{ "ISO646String",		NULL,			berVISIBLESTRING },
+	{ "GeneralString",		NULL,			berGENERALSTRING },
+	{ "UniversalString",	NULL,			berUNIVERSALSTRING },
+	{ "BMPString",			NULL,			berBMPSTRING },
+	{ NULL,					NULL,			0 }
+};
+
+
+static int	 AddKey (long, int, long, long);
+static int	 AddKeys (long, long, long, int);
+static long	 Assign (long, int, long, SchemaInfo *);
+static int	 CompareNames (const void *, const void *);
+static long	 FindAssigned (const char *, int);
+static long	 FindKey (long, int, long);
+static long	 NewComp (void);
+static long	 NewType (int);
+static int	 ParseAssignment (void);
+static int	 ParseComponents (long);
+static long	 ParseType (void);
+static int	 Resolve (void);
+static void	 SkipBalanced (void);
+static void	 SkipConstraints (void);
+static void	 SkipStatement (void);
+static long	 Target (long);
+static int	 Tokenize (const char *, long);
+static const char	*TypeName (long, int *);
+
+
+/* Token helpers */
+# define	TOK				(tp < ntokens ? &tokens[tp] : &tokens[ntokens])
+# define	IS(s)			(tp < ntokens && TokIs (&tokens[tp], s))
+# define	ISAT(i,s)		(tp + (i) < ntokens && TokIs (&tokens[tp + (i)], s))
+# define	UPPER(t)		((t)->len > 0 && isupper ((byte)(t)->p[0]))
+# define	LOWER(t)		((t)->len > 0 && islower ((byte)(t)->p[0]))
+
+static int TokIs (const Token *t, const char *s) {
+	return (int)strlen (s) == t->len && memcmp (t->p, s, (size_t)t->len) == 0;
+}
+
+
+/*:>* schema.c **************************************************************
+
+Name
+	schemaLoad
+
+Info
+	Load an ASN.1 module
+
+Syntax
+	int schemaLoad (const char *fn);
+
+Include
+	schema.h
+
+Description
+	`schemaLoad()` reads the ASN.1 modules in the file `fn`. The file is
+	mapped into memory and stays mapped, names aren't copied. Only one
+	file can be loaded, but it may contain several modules. Type
+	references to types which aren't defined in the file are treated as
+	ANY.
+
+Return value
+	The function returns the number of assigned types or -1 if the file
+	can't be read or isn't an ASN.1 module.
+
+See also
+	schemaChild
+	schemaRoot
+
+**************************************************************************<:*/
+
+int schemaLoad (const char *fn) {
+	static MappedFile	 mf;
+	int					 modules;
+
+	fname= fn;
+	if (mapOpen (&mf, fn) == -1)
+		return -1;
+	if (Tokenize ((const char *)mf.data, mf.length) == -1)
+		return -1;
+
+	NewType (stROOT);						/* type 0 holds all assigned types */
+	for (tp= 0, modules= 0; tp < ntokens; ) {
+		/* ModuleName [ { oid } ] DEFINITIONS [ tagging TAGS ] [ EXTENSIBILITY IMPLIED ] ::= BEGIN */
+		while (tp < ntokens && !IS ("DEFINITIONS"))
+			tp++;
+		if (tp == ntokens)
+			break;
+		tagdefault= 0;
+		for (; tp < ntokens && !IS ("::="); tp++)
+			if (IS ("IMPLICIT"))
+				tagdefault= 1;
+			else if (IS ("AUTOMATIC"))
+				tagdefault= 2;
+		tp++;
+		if (!IS ("BEGIN")) {
+			fprintf (stderr, "%s: line %ld: BEGIN expected\n", fn, TOK->line);
+			return -1;
+		}
+		tp++;
+		modules++;
+
+		while (tp < ntokens && !IS ("END"))
+			if (ParseAssignment () == -1)
+				return -1;
+		tp++;
+	}
+	if (modules == 0) {
+		fprintf (stderr, "%s: no ASN.1 module found\n", fn);
+		return -1;
+	}
+	if (Resolve () == -1)
+		return -1;
+	return (int)nassigned;
+}
+
+
+/*:>* schema.c **************************************************************
+
+Name
+	schemaRoot
+
+Info
+	Get the context for top-level elements
+
+Syntax
+	long schemaRoot (const char *type);
+
+Include
+	schema.h
+
+Description
+	`schemaRoot()` returns the context which is passed to `schemaChild()`
+	for the top-level elements of a file. If `type` is given, the top-level
+	elements are of this type. Otherwise the type of a top-level element is
+	the first assigned type of the module which has the tag of the element.
+
+Return value
+	The function returns the context or -1 if `type` isn't defined.
+
+See also
+	schemaChild
+
+**************************************************************************<:*/
+
+long schemaRoot (const char *type) {
+	long	 t;
+
+	if (ntypes == 0)
+		return -1;
+	if (type == NULL)
+		return 0;							/* children of stROOT */
+	if ((t= FindAssigned (type, (int)strlen (type))) == -1)
+		return -1;
+	return 2 * t + 1;						/* the element is of type t */
+}
+
+
+/*:>* schema.c **************************************************************
+
+Name
+	schemaChild
+
+Info
+	Find the component and type of an element
+
+Syntax
+	long schemaChild (long context, int cl, long tag, SchemaInfo *info);
+
+Include
+	schema.h
+
+Description
+	`schemaChild()` determines the component name and the type of an
+	element with the class `cl` and the tag number `tag`. `context` is the
+	value returned by `schemaChild()` for the parent element, or by
+	`schemaRoot()` for top-level elements. The result is stored in `info`.
+	A CHOICE is resolved to the alternative with the tag of the element.
+	For primitive built-in types `info->utag` is set to their universal
+	tag, so a context-specific element can be decoded like a universal one.
+
+Return value
+	The function returns the context for the children of the element or
+	-1 if the schema doesn't know about them.
+
+See also
+	schemaRoot
+
+**************************************************************************<:*/
+
+long schemaChild (long ctx, int cl, long tag, SchemaInfo *info) {
+	long	 t,
+			 c;
+
+	info->field= NULL;
+	info->alt= NULL;
+	info->type= NULL;
+	info->utag= -1;
+	if (ctx < 0)
+		return -1;
+
+	t= ctx >> 1;
+	if (ctx & 1)							/* element of type t */
+		return Assign (t, cl, tag, info);
+
+	switch (types[t].kind) {
+		case stSEQOF:
+		case stSETOF:
+			return Assign (types[t].inner, cl, tag, info);
+		case stROOT:
+		case stSEQUENCE:
+		case stSET:
+			if ((c= FindKey (t, cl, tag)) == -1)
+				return -1;
+			if (comps[c].namelen > 0) {
+				info->field= comps[c].name;
+				info->fieldlen= comps[c].namelen;
+			}
+			return Assign (comps[c].type, cl, tag, info);
+	}
+	return -1;
+}
+
+
+/****************************************************************************/
+
+/*
+ * The element has type t, follow references and implicit tags to the
+ * type which determines its content
+ */
+
+static long Assign (long t, int cl, long tag, SchemaInfo *info) {
+	long	 c;
+	int		 depth;
+
+	for (depth= 0; t >= 0 && depth < MAXDEPTH; depth++) {
+		if (info->type == NULL)
+			info->type= TypeName (t, &info->typelen);
+
+		switch (types[t].kind) {
+			case stREF:
+				t= types[t].inner;
+				break;
+			case stTAGGED:
+				if (types[t].explicit)
+					return 2 * types[t].inner + 1;
+				t= types[t].inner;
+				break;
+			case stCHOICE:
+				if ((c= FindKey (t, cl, tag)) == -1)
+					return -1;
+				info->alt= comps[c].name;
+				info->altlen= comps[c].namelen;
+				info->type= NULL;
+				t= comps[c].type;
+				break;
+			case stPRIM:
+				info->utag= (int)types[t].tag;
+				return -1;
+			case stSEQUENCE:
+			case stSET:
+			case stSEQOF:
+			case stSETOF:
+				return 2 * t;
+			default:
+				return -1;
+		}
+	}
+	return -1;
+}
+
+
+/*
+ * Name of a type for the output
+ */
+
+static const char *TypeName (long t, int *len) {
+	int		 i;
+
+	for (; t >= 0; t= types[t].inner) {
+		if (types[t].name) {
+			*len= types[t].namelen;
+			return types[t].name;
+		}
+		switch (types[t].kind) {
+			case stREF:
+				*len= types[t].reflen;
+				return types[t].ref;
+			case stTAGGED:
+				continue;
+			case stPRIM:
+				switch (types[t].tag) {
+					case berBITSTRING:		*len= 10;	return "BIT STRING";
+					case berOCTETSTRING:	*len= 12;	return "OCTET STRING";
+					case berOBJECTID:		*len= 17;	return "OBJECT IDENTIFIER";
+				}
+				for (i= 0; builtins[i].name; i++)
+					if (builtins[i].utag == types[t].tag) {
+						*len= (int)strlen (builtins[i].name);
+						return builtins[i].name;
+					}
+				return NULL;
+			case stSEQUENCE:	*len= 8;	return "SEQUENCE";
+			case stSET:			*len= 3;	return "SET";
+			case stCHOICE:		*len= 6;	return "CHOICE";
+			case stSEQOF:		*len= 11;	return "SEQUENCE OF";
+			case stSETOF:		*len= 6;	return "SET OF";
+		}
+		break;
+	}
+	return NULL;
+}
+
+
+/*
+ * Split the file into tokens
+ */
+
+static int Tokenize (const char *p, long length) {
+	const char	*end,
+				*s;
+	Token		*tmp;
+	long		 line,
+				 n;
+
+	end= p + length;
+	line= 1;
+	while (p < end) {
+		if (*p == '\n') {
+			line++;
+			p++;
+			continue;
+		}
+		if (isspace ((byte)*p)) {
+			p++;
+			continue;
+		}
+		if (p + 1 < end && p[0] == '-' && p[1] == '-') {		/* comment */
+			for (p+= 2; p < end && *p != '\n'; p++)
+				if (p + 1 < end && p[0] == '-' && p[1] == '-') {
+					p+= 2;
+					break;
+				}
+			continue;
+		}
+		if (p + 1 < end && p[0] == '/' && p[1] == '*') {
+			for (p+= 2; p + 1 < end && !(p[0] == '*' && p[1] == '/'); p++)
+				if (*p == '\n')
+					line++;
+			p+= 2;
+			continue;
+		}
+
+		s= p;
+		if (isalnum ((byte)*p) || (*p == '-' && p + 1 < end && isdigit ((byte)p[1]))) {
+			for (p++; p < end && (isalnum ((byte)*p) || *p == '_' ||
+					 (*p == '-' && p + 1 < end && isalnum ((byte)p[1]))); p++)
+				/* empty */ ;
+		} else if (*p == '"' || *p == '\'') {					/* strings */
+			for (p++; p < end && *p != *s; p++)
+				if (*p == '\n')
+					line++;
+			p++;
+			if (p < end && *s == '\'' && (*p == 'B' || *p == 'H'))
+				p++;
+		} else if (end - p >= 3 && memcmp (p, "::=", 3) == 0)
+			p+= 3;
+		else if (end - p >= 3 && memcmp (p, "...", 3) == 0)
+			p+= 3;
+		else if (end - p >= 2 && memcmp (p, "..", 2) == 0)
+			p+= 2;
+		else
+			p++;
+
+		if (ntokens + 1 >= tokensize) {
+			n= ntokens ? 2 * ntokens : 4096;
+			if ((tmp= realloc (tokens, (n + 1) * sizeof(Token))) == NULL)
+				return -1;
+			tokens= tmp;
+			tokensize= n;
+		}
+		tokens[ntokens].p= s;
+		tokens[ntokens].len= (int)((p < end ? p : end) - s);
+		tokens[ntokens].line= line;
+		ntokens++;
+	}
+	if (tokens == NULL && (tokens= malloc (sizeof(Token))) == NULL)
+		return -1;
+	tokens[ntokens].p= "";					/* sentinel */
+	tokens[ntokens].len= 0;
+	tokens[ntokens].line= line;
+	return 0;
+}
+
+
+/*
+ * Skip a balanced group of (), {} or [] and everything in it
+ */
+
+static void SkipBalanced (void) {
+	int		 depth;
+
+	depth= 0;
+	do {
+		if (IS ("(") || IS ("{") || IS ("["))
+			depth++;
+		else if (IS (")") || IS ("}") || IS ("]"))
+			depth--;
+		tp++;
+	} while (depth > 0 && tp < ntokens);
+}
+
+static void SkipConstraints (void) {
+	while (IS ("("))
+		SkipBalanced ();
+}
+
+
+/*
+ * Skip up to the beginning of the next assignment
+ */
+
+static void SkipStatement (void) {
+	int		 depth;
+
+	for (depth= 0; tp < ntokens; tp++) {
+		if (IS ("(") || IS ("{") || IS ("["))
+			depth++;
+		else if (IS (")") || IS ("}") || IS ("]"))
+			depth--;
+		else if (depth <= 0 && tp > 0 && !TokIs (&tokens[tp - 1], "::=")) {
+			if (IS ("END") || (UPPER (TOK) && ISAT (1, "::=")) ||
+				(LOWER (TOK) && UPPER (&tokens[tp + 1]) && 
+				 (ISAT (2, "::=") || (ISAT (3, "::=") && UPPER (&tokens[tp + 2])))))
+				return;
+		}
+	}
+}
+
+
+/*
+ * TypeReference ::= Type, everything else is skipped
+ */
+
+static int ParseAssignment (void) {
+	Token	*name;
+	long	 start,
+			 t;
+
+	if (IS ("IMPORTS") || IS ("EXPORTS")) {
+		while (tp < ntokens && !IS (";"))
+			tp++;
+		tp++;
+		return 0;
+	}
+
+	name= TOK;
+	start= tp;
+	if (UPPER (name) && ISAT (1, "::=")) {
+		tp+= 2;
+		if ((t= ParseType ()) >= 0) {
+			types[t].name= name->p;
+			types[t].namelen= name->len;
+			if (!IS ("END") && !(tp + 1 < ntokens && TokIs (&tokens[tp + 1], "::=")) &&
+				!(LOWER (TOK)))
+				SkipStatement ();			/* e.g. a trailing constraint */
+			return 0;
+		}
+		if (t == -1)
+			return -1;
+		fprintf (stderr, "%s: line %ld: can't parse type '%.*s', skipped\n", 
+				 fname, name->line, name->len, name->p);
+		tp= start + 2;
+	} else {
+		/* value assignment, parameterized type etc.: skip the left side */
+		while (tp < ntokens && !IS ("::=") && !IS ("END"))
+			if (IS ("{") || IS ("(") || IS ("["))
+				SkipBalanced ();
+			else
+				tp++;
+		tp++;
+	}
+	SkipStatement ();
+	return 0;
+}
+
+
+/*
+ * Parse a type, returns its index, -1 if out of memory or -2 on a
+ * syntax error
+ */
+
+static long ParseType (void) {
+	Token	*r;
+	long	 t,
+			 inner;
+	int		 kind,
+			 cl,
+			 explicit,
+			 i;
+	long	 tag;
+
+	if (IS ("[")) {							/* tagged type */
+		tp++;
+		cl= berCONTEXT;
+		if (IS ("UNIVERSAL"))
+			cl= berUNIVERSAL;
+		else if (IS ("APPLICATION"))
+			cl= berAPPLICATION;
+		else if (IS ("PRIVATE"))
+			cl= berPRIVATE;
+		if (cl != berCONTEXT)
+			tp++;
+		if (!isdigit ((byte)TOK->p[0]))
+			return -2;
+		for (tag= 0, i= 0; i < TOK->len && isdigit ((byte)TOK->p[i]); i++)
+			tag= tag * 10 + (TOK->p[i] - '0');
+		tp++;
+		if (!IS ("]"))
+			return -2;
+		tp++;
+		explicit= (tagdefault == 0);
+		if (IS ("IMPLICIT")) {
+			explicit= 0;
+			tp++;
+		} else if (IS ("EXPLICIT")) {
+			explicit= 1;
+			tp++;
+		}
+		if ((t= NewType (stTAGGED)) < 0)
+			return t;
+		if ((inner= ParseType ()) < 0)
+			return inner;
+		types[t].cl= cl;
+		types[t].tag= tag;
+		types[t].explicit= explicit;
+		types[t].inner= inner;
+		return t;
+	}
+
+	if (IS ("SEQUENCE") || IS ("SET")) {
+		kind= IS ("SEQUENCE") ? stSEQUENCE : stSET;
+		tp++;
+		if (IS ("SIZE"))
+			tp++;
+		SkipConstraints ();
+		if (IS ("OF")) {
+			tp++;
+			if (LOWER (TOK) && (ISAT (1, "[") || UPPER (&tokens[tp + 1])))
+				tp++;						/* SEQUENCE OF identifier Type */
+			if ((t= NewType (kind == stSEQUENCE ? stSEQOF : stSETOF)) < 0)
+				return t;
+			if ((inner= ParseType ()) < 0)
+				return inner;
+			types[t].inner= inner;
+			return t;
+		}
+		if (!IS ("{"))
+			return -2;
+		if ((t= NewType (kind)) < 0)
+			return t;
+		if ((i= ParseComponents (t)) < 0)
+			return i;
+		SkipConstraints ();
+		return t;
+	}
+
+	if (IS ("CHOICE")) {
+		tp++;
+		if (!IS ("{"))
+			return -2;
+		if ((t= NewType (stCHOICE)) < 0)
+			return t;
+		if ((i= ParseComponents (t)) < 0)
+			return i;
+		SkipConstraints ();
+		return t;
+	}
+
+	if (IS ("ANY")) {
+		tp++;
+		if (IS ("DEFINED"))
+			tp+= 3;
+		return NewType (stANY);
+	}
+
+	for (i= 0; builtins[i].name; i++)
+		if (IS (builtins[i].name) && (builtins[i].second == NULL || ISAT (1, builtins[i].second))) {
+			tp+= (builtins[i].second != NULL) ? 2 : 1;
+			if ((t= NewType (stPRIM)) < 0)
+				return t;
+			types[t].tag= builtins[i].utag;
+			if (IS ("{"))					/* named numbers or bits */
+				SkipBalanced ();
+			SkipConstraints ();
+			return t;
+		}
+
+	if (UPPER (TOK)) {						/* type reference */
+		r= TOK;
+		tp++;
+		if (IS (".") && UPPER (&tokens[tp + 1])) {
+			tp++;							/* Module.Type */
+			r= TOK;
+			tp++;
+		}
+		if (IS ("{"))						/* actual parameters */
+			SkipBalanced ();
+		if ((t= NewType (stREF)) < 0)
+			return t;
+		types[t].ref= r->p;
+		types[t].reflen= r->len;
+		SkipConstraints ();
+		return t;
+	}
+	return -2;
+}
+
+
+/*
+ * Parse the components of a SEQUENCE, SET or CHOICE
+ */
+
+static int ParseComponents (long t) {
+	SchemaComp	*list,
+				*tmp;
+	long		 n,
+				 size,
+				 c,
+				 ct,
+				 i;
+	int			 tagged;
+
+	list= NULL;
+	n= 0;
+	size= 0;
+	tagged= 0;
+	tp++;									/* { */
+	for (;;) {
+		if (tp >= ntokens) {
+			free (list);
+			return -2;
+		}
+		if (IS ("}")) {
+			tp++;
+			break;
+		}
+		if (IS (",")) {
+			tp++;
+			continue;
+		}
+		if ((IS ("[") && ISAT (1, "[")) || (IS ("]") && ISAT (1, "]"))) {
+			tp+= 2;							/* version brackets */
+			continue;
+		}
+		if (IS ("...")) {					/* extension marker */
+			for (tp++; tp < ntokens && !IS (",") && !IS ("}"); tp++)
+				if (IS ("(") || IS ("{"))
+					SkipBalanced (), tp--;
+			continue;
+		}
+		if (IS ("COMPONENTS") && ISAT (1, "OF")) {
+			tp+= 2;
+			if ((ct= ParseType ()) < 0) {
+				free (list);
+				return (int)ct;
+			}
+			continue;						/* not supported */
+		}
+		if (!LOWER (TOK)) {
+			free (list);
+			return -2;
+		}
+
+		if (n >= size) {
+			size= size ? 2 * size : 32;
+			if ((tmp= realloc (list, size * sizeof(SchemaComp))) == NULL) {
+				free (list);
+				return -1;
+			}
+			list= tmp;
+		}
+		list[n].name= TOK->p;
+		list[n].namelen= TOK->len;
+		tp++;
+		if (IS ("["))
+			tagged= 1;
+		if ((ct= ParseType ()) < 0) {
+			free (list);
+			return (int)ct;
+		}
+		list[n++].type= ct;
+		if (IS ("OPTIONAL"))
+			tp++;
+		else if (IS ("DEFAULT")) {
+			tp++;
+			if (IS ("{"))
+				SkipBalanced ();
+			else
+				tp++;
+		}
+	}
+
+	/* the components of one type must be consecutive */
+	types[t].first= ncomps;
+	types[t].count= n;
+	for (i= 0; i < n; i++) {
+		if ((c= NewComp ()) < 0) {
+			free (list);
+			return -1;
+		}
+		comps[c]= list[i];
+		if (tagdefault == 2 && !tagged) {	/* automatic tagging */
+			if ((ct= NewType (stTAGGED)) < 0) {
+				free (list);
+				return -1;
+			}
+			types[ct].cl= berCONTEXT;
+			types[ct].tag= i;
+			types[ct].explicit= 0;
+			types[ct].inner= comps[c].type;
+			comps[c].type= ct;
+		}
+	}
+	free (list);
+	return 0;
+}
+
+
+/*
+ * Resolve the type references and build the hash table
+ */
+
+static int Resolve (void) {
+	long	 t,
+			 c;
+	int		 kind;
+
+	/* assigned types by name */
+	if ((assigned= malloc ((ntypes + 1) * sizeof(long))) == NULL)
+		return -1;
+	for (t= 0, nassigned= 0; t < ntypes; t++)
+		if (types[t].name)
+			assigned[nassigned++]= t;
+	qsort (assigned, (size_t)nassigned, sizeof(long), CompareNames);
+
+	for (t= 0; t < ntypes; t++)
+		if (types[t].kind == stREF &&
+			(types[t].inner= FindAssigned (types[t].ref, types[t].reflen)) == -1)
+			types[t].kind= stANY;			/* not defined in the file */
+
+	/* a tagged CHOICE or ANY is always explicitly tagged */
+	for (t= 0; t < ntypes; t++)
+		if (types[t].kind == stTAGGED && !types[t].explicit) {
+			kind= types[Target (types[t].inner)].kind;
+			if (kind == stCHOICE || kind == stANY)
+				types[t].explicit= 1;
+		}
+
+	for (t= 0; t < ntypes; t++) {
+		kind= types[t].kind;
+		if (kind == stSEQUENCE || kind == stSET || kind == stCHOICE)
+			for (c= types[t].first; c < types[t].first + types[t].count; c++)
+				if (AddKeys (t, comps[c].type, c, 0) == -1)
+					return -1;
+	}
+
+	/* top-level elements: the first type with the tag wins */
+	for (t= 0; t < ntypes; t++) {
+		if (types[t].name == NULL)
+			continue;
+		if ((c= NewComp ()) < 0)
+			return -1;
+		comps[c].name= NULL;
+		comps[c].namelen= 0;
+		comps[c].type= t;
+		if (AddKeys (0, t, c, 0) == -1)
+			return -1;
+	}
+	return 0;
+}
+
+
+/*
+ * The type behind a chain of references
+ */
+
+static long Target (long t) {
+	int		 depth;
+
+	for (depth= 0; types[t].kind == stREF && depth < MAXDEPTH; depth++)
+		t= types[t].inner;
+	return t;
+}
+
+
+/*
+ * Add the outer tags of type t as keys for component c of parent
+ */
+
+static int AddKeys (long parent, long t, long c, int depth) {
+	long	 a;
+
+	if (depth > MAXDEPTH)
+		return 0;
+	switch (types[t].kind) {
+		case stTAGGED:
+			return AddKey (parent, types[t].cl, types[t].tag, c);
+		case stREF:
+			return AddKeys (parent, types[t].inner, c, depth + 1);
+		case stPRIM:
+			return AddKey (parent, berUNIVERSAL, types[t].tag, c);
+		case stSEQUENCE:
+		case stSEQOF:
+			return AddKey (parent, berUNIVERSAL, berSEQUENCE, c);
+		case stSET:
+		case stSETOF:
+			return AddKey (parent, berUNIVERSAL, berSET, c);
+		case stCHOICE:
+			for (a= types[t].first; a < types[t].first + types[t].count; a++)
+				if (AddKeys (parent, comps[a].type, c, depth + 1) == -1)
+					return -1;
+			return 0;
+	}
+	return 0;
+}
+
+
+/*
+ * The hash table (type, class, tag) -> component
+ */
+
+# define	HASHKEY(t,cl,tag)	((unsigned long)(t) * 0x9e3779b1UL ^ (unsigned long)(tag) * 0x85ebca6bUL ^ (unsigned long)(cl))
+
+static int AddKey (long t, int cl, long tag, long c) {
+	SchemaKey	*old;
+	long		 oldsize,
+				 i,
+				 h;
+
+	if (FindKey (t, cl, tag) != -1)
+		return 0;							/* the first one wins */
+
+	if (2 * (nkeys + 1) > sizekeys) {		/* grow and rehash */
+		old= keys;
+		oldsize= sizekeys;
+		sizekeys= sizekeys ? 2 * sizekeys : 1024;
+		if ((keys= malloc (sizekeys * sizeof(SchemaKey))) == NULL)
+			return -1;
+		for (i= 0; i < sizekeys; i++)
+			keys[i].type= -1;
+		nkeys= 0;
+		for (i= 0; i < oldsize; i++)
+			if (old[i].type != -1)
+				AddKey (old[i].type, old[i].cl, old[i].tag, old[i].comp);
+		free (old);
+	}
+
+	h= (long)(HASHKEY(t, cl, tag) & (unsigned long)(sizekeys - 1));
+	while (keys[h].type != -1)
+		h= (h + 1) & (sizekeys - 1);
+	keys[h].type= t;
+	keys[h].cl= cl;
+	keys[h].tag= tag;
+	keys[h].comp= c;
+	nkeys++;
+	return 0;
+}
+
+static long FindKey (long t, int cl, long tag) {
+	long	 h;
+
+	if (sizekeys == 0)
+		return -1;
+	h= (long)(HASHKEY(t, cl, tag) & (unsigned long)(sizekeys - 1));
+	for (; keys[h].type != -1; h= (h + 1) & (sizekeys - 1))
+		if (keys[h].type == t && keys[h].tag == tag && keys[h].cl == cl)
+			return keys[h].comp;
+	return -1;
+}
+
+
+/*
+ * Find an assigned type by name
+ */
+
+static int CompareNames (const void *p1, const void *p2) {
+	const SchemaType	*t1= &types[*(const long *)p1],
+						*t2= &types[*(const long *)p2];
+	int					 c;
+
+	c= memcmp (t1->name, t2->name, (size_t)(t1->namelen < t2->namelen ? t1->namelen : t2->namelen));
+	if (c == 0 && t1->namelen != t2->namelen)
+		c= t1->namelen - t2->namelen;
+	if (c == 0)								/* keep the first definition first */
+		c= (*(const long *)p1 < *(const long *)p2) ? -1 : 1;
+	return c;
+}
+
+static long FindAssigned (const char *name, int len) {
+	long	 lo,
+			 hi,
+			 mid;
+	int		 c;
+	SchemaType	*t;
+
+	lo= 0;
+	hi= nassigned;
+	while (lo < hi) {
+		mid= (lo + hi) / 2;
+		t= &types[assigned[mid]];
+		c= memcmp (t->name, name, (size_t)(t->namelen < len ? t->namelen : len));
+		if (c == 0)
+			c= t->namelen - len;
+		if (c < 0)
+			lo= mid + 1;
+		else
+			hi= mid;
+	}
+	if (lo < nassigned && types[assigned[lo]].namelen == len &&
+		memcmp (types[assigned[lo]].name, name, (size_t)len) == 0)
+		return assigned[lo];
+	return -1;
+}
+
+
+/*
+ * Allocate types and components
+ */
+
+static long NewType (int kind) {
+	SchemaType	*tmp;
+	long		 n;
+
+	if (ntypes >= sizetypes) {
+		n= sizetypes ? 2 * sizetypes : 1024;
+		if ((tmp= realloc (types, n * sizeof(SchemaType))) == NULL)
+			return -1;
+		types= tmp;
+		sizetypes= n;
+	}
+	memset (&types[ntypes], 0, sizeof(SchemaType));
+	types[ntypes].kind= kind;
+	types[ntypes].inner= -1;
+	return ntypes++;
+}
+
+static long NewComp (void) {
+	SchemaComp	*tmp;
+	long		 n;
+
+	if (ncomps >= sizecomps) {
+		n= sizecomps ? 2 * sizecomps : 1024;
+		if ((tmp= realloc (comps, n * sizeof(SchemaComp))) == NULL)
+			return -1;
+		comps= tmp;
+		sizecomps= n;
+	}
+	return ncomps++;
+}
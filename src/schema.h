@@ -0,0 +1,29 @@
+/*
+ *	schema.h
+ *
+ *	Includefile for schema.c
+ */
+
+#ifndef __SCHEMA_H__
+#define __SCHEMA_H__
+
+#include "vlARGS.h"
+
+/*
+ *	What the schema knows about an element
+ */
+typedef struct {
+	const char	*field;			/* name of the component or NULL		*/
+	int			 fieldlen;
+	const char	*alt;			/* selected CHOICE alternative or NULL	*/
+	int			 altlen;
+	const char	*type;			/* name of the type or NULL				*/
+	int			 typelen;
+	int			 utag;			/* universal tag of the value or -1		*/
+} SchemaInfo;
+
+EXTERN int		 schemaLoad (const char *);
+EXTERN long		 schemaRoot (const char *);
+EXTERN long		 schemaChild (long, int, long, SchemaInfo *);
+
+#endif
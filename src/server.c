@@ -0,0 +1,421 @@
+/*
+ *	server.c
+ *
+ *	Render elements for clients on a Unix domain socket, so that a tool
+ *	which decodes many small PDUs doesn't start a process for each.
+ */
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	<string.h>
+# include	"mapfile.h"
+# include	"server.h"
+
+# if defined(__GNUC__) && (defined(__unix__) || defined(__APPLE__)) && !defined(NO_THREADS)
+# define	HAS_SOCKETS
+# include	<pthread.h>
+# include	<signal.h>
+# include	<errno.h>
+# include	<unistd.h>
+# include	<sys/types.h>
+# include	<sys/stat.h>
+# include	<sys/socket.h>
+# include	<sys/un.h>
+# endif
+
+# define	MAXLINE			4096		/* longest request line					*/
+# define	MAXPAYLOAD		(1L << 28)	/* largest element sent with BER		*/
+
+# ifdef HAS_SOCKETS
+
+/*
+ *	Buffered reading from a connection
+ */
+typedef struct {
+	int			 fd;
+	char		 buf[MAXLINE];
+	long		 start;
+	long		 end;
+} Reader;
+
+typedef struct {
+	int			 listener;
+	ServeFunc	 render;
+} Server;
+
+static int		 Connect (const char *);
+static void		*Handle (void *);
+static int		 ReadFull (Reader *, char *, long);
+static int		 ReadLine (Reader *, char *, long);
+static int		 Reply (int, const char *, OutBuf *);
+static int		 Request (Server *, Reader *, OutBuf *);
+static int		 WriteFull (int, const char *, long);
+
+# endif
+
+
+/*:>* server.c **************************************************************
+
+Name
+	srvServe
+
+Info
+	Render elements for clients on a socket
+
+Syntax
+	int srvServe (const char *path, int threads, ServeFunc render);
+
+Include
+	server.h
+
+Description
+	`srvServe()` listens on the Unix domain socket `path`, which is
+	replaced if it exists, and answers requests with `threads` threads.
+	Each thread takes a connection and answers its requests one after
+	the other until the client closes it.$
+	A request is a line, followed by the data for `BER`:
+	% BER <length> [<flags>]\n<length bytes of BER>
+	% FILE <offset> <count> [<flags>] <path>\n
+	`BER` renders all elements of the data sent. `FILE` maps the file
+	`path` of the server's file system and renders `count` elements at
+	`offset`, or all elements up to the end if `count` is -1. The optional
+	`flags` are a word like "context,oids"; before a path they can't
+	contain a '/', so a relative path with blanks needs a leading "./".
+	The elements are rendered by `render(data, length, pos, count, flags,
+	out)` on the thread of the connection, with `flags` "" if there are
+	none. It returns 0, -1 if `pos` is outside `data` or -2 for unknown
+	flags. If `failed` of `out` is set afterwards, the text is incomplete
+	for lack of memory and an error is sent instead.$
+	The answer is the rendered text with its length, or a message:
+	% OK <length>\n<length bytes of text>
+	% ERR <message>\n$
+	The server runs until it gets SIGINT or SIGTERM, then the socket is
+	removed.
+
+Return value
+	The function returns 0 after a signal, or -1 if the socket can't be
+	created or there are no threads or sockets on this system.
+
+See also
+	srvCall
+
+**************************************************************************<:*/
+
+int srvServe (const char *path, int threads, ServeFunc render) {
+# ifdef HAS_SOCKETS
+	struct sockaddr_un	 addr;
+	struct stat			 st;
+	Server				 server;
+	pthread_t			 tid;
+	sigset_t			 signals;
+	int					 i,
+						 sig;
+
+	if (strlen (path) >= sizeof(addr.sun_path)) {
+		fprintf (stderr, "asn1dump: socket path '%s' is too long\n", path);
+		return -1;
+	}
+	memset (&addr, 0, sizeof(addr));
+	addr.sun_family= AF_UNIX;
+	strcpy (addr.sun_path, path);
+	if (stat (path, &st) == 0 && S_ISSOCK (st.st_mode))
+		unlink (path);					/* left by an earlier server */
+	if ((server.listener= socket (AF_UNIX, SOCK_STREAM, 0)) == -1 ||
+		bind (server.listener, (struct sockaddr *)&addr, sizeof(addr)) == -1 ||
+		listen (server.listener, 64) == -1) {
+		perror (path);
+		return -1;
+	}
+	server.render= render;
+
+	/* the signals are taken by this thread only */
+	sigemptyset (&signals);
+	sigaddset (&signals, SIGINT);
+	sigaddset (&signals, SIGTERM);
+	pthread_sigmask (SIG_BLOCK, &signals, NULL);
+	signal (SIGPIPE, SIG_IGN);			/* a client went away, write() tells */
+
+	for (i= 0; i < (threads > 0 ? threads : 1); i++)
+		if (pthread_create (&tid, NULL, Handle, &server) == 0)
+			pthread_detach (tid);
+		else if (i == 0) {
+			perror ("pthread_create");
+			unlink (path);
+			return -1;
+		}
+
+	sigwait (&signals, &sig);
+	close (server.listener);
+	unlink (path);
+	return 0;
+# else
+	fprintf (stderr, "asn1dump: no server on this system\n");
+	return -1;
+# endif
+}
+
+
+/*:>* server.c **************************************************************
+
+Name
+	srvCall
+
+Info
+	Send a request to a server
+
+Syntax
+	int srvCall (const char *path, const char *request, const byte *data,
+				 long length, OutBuf *answer);
+
+Include
+	server.h
+
+Description
+	`srvCall()` connects to the server at the socket `path` and sends the
+	request line `request` (without the newline), followed by `length`
+	bytes of `data` for a `BER` request. The text of an `OK` answer, or
+	the message of an `ERR` answer, is appended to `answer`.
+
+Return value
+	The function returns `srvOK`, `srvERROR` for an `ERR` answer or
+	`srvFAILED` if the server can't be reached or the answer is broken.
+
+Example
+	% sprintf (line, "BER %ld", length);
+	% if (srvCall ("/tmp/asn1dump.sock", line, data, length, &out) == srvOK)
+	%	obFlush (&out, stdout);
+
+See also
+	srvServe
+
+**************************************************************************<:*/
+
+int srvCall (const char *path, const char *request, const byte *data, long length, OutBuf *answer) {
+# ifdef HAS_SOCKETS
+	Reader	 r;
+	char	 line[MAXLINE];
+	long	 n,
+			 part;
+	int		 rc;
+
+	if ((r.fd= Connect (path)) == -1)
+		return srvFAILED;
+	r.start= r.end= 0;
+	rc= srvFAILED;
+	if (WriteFull (r.fd, request, (long)strlen (request)) == 0 &&
+		WriteFull (r.fd, "\n", 1) == 0 &&
+		(data == NULL || WriteFull (r.fd, (const char *)data, length) == 0) &&
+		ReadLine (&r, line, sizeof(line)) == 0) {
+		if (strncmp (line, "OK ", 3) == 0 && (n= atol (line + 3)) >= 0) {
+			for (; n > 0; n-= part) {
+				part= n < MAXLINE ? n : MAXLINE;
+				if (ReadFull (&r, line, part) == -1 || obWrite (answer, line, part) == -1)
+					break;
+			}
+			if (n == 0)
+				rc= srvOK;
+		} else if (strncmp (line, "ERR ", 4) == 0) {
+			obPrintf (answer, "%s\n", line + 4);
+			rc= srvERROR;
+		}
+	}
+	close (r.fd);
+	return rc;
+# else
+	return srvFAILED;
+# endif
+}
+
+
+# ifdef HAS_SOCKETS
+
+/*
+ * a thread of the server, answers one connection at a time
+ */
+
+static void *Handle (void *arg) {
+	Server	*server= arg;
+	Reader	 r;
+	OutBuf	 out;
+
+	obInit (&out);
+	for (;;) {
+		if ((r.fd= accept (server->listener, NULL, NULL)) == -1) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			break;						/* the listener was closed */
+		}
+		r.start= r.end= 0;
+		while (Request (server, &r, &out) == 0)
+			;
+		close (r.fd);
+	}
+	obFree (&out);
+	return NULL;
+}
+
+/*
+ * read and answer one request, returns -1 at the end of the connection
+ */
+
+static int Request (Server *server, Reader *r, OutBuf *out) {
+	MappedFile	 mf;
+	char		 line[MAXLINE],
+				*data,
+				*flags,
+				*path,
+				*p;
+	long		 length,
+				 pos,
+				 count;
+	int			 n,
+				 rc;
+
+	if (ReadLine (r, line, sizeof(line)) == -1)
+		return -1;
+	out->length= 0;
+	out->failed= 0;
+
+	if (sscanf (line, "BER %ld%n", &length, &n) == 1) {
+		if (length < 0 || length > MAXPAYLOAD) {
+			Reply (r->fd, "payload too large", NULL);
+			return -1;					/* the payload isn't read */
+		}
+		if ((data= malloc ((size_t)length + 1)) == NULL) {
+			Reply (r->fd, "not enough memory", NULL);
+			return -1;
+		}
+		if (ReadFull (r, data, length) == -1) {
+			free (data);
+			return -1;
+		}
+		flags= line + n + strspn (line + n, " ");
+		rc= server->render ((const byte *)data, length, 0, -1, flags, out);
+		free (data);
+		if (rc == -2)
+			return Reply (r->fd, "unknown flag", NULL);
+		if (out->failed)
+			return Reply (r->fd, "not enough memory", NULL);
+		return Reply (r->fd, rc == -1 ? "offset outside the data" : NULL, out);
+	} /* if */
+
+	if (sscanf (line, "FILE %ld %ld %n", &pos, &count, &n) == 2) {
+		path= line + n;
+		flags= "";
+		if ((p= strchr (path, ' ')) != NULL && memchr (path, '/', (size_t)(p - path)) == NULL) {
+			*p= '\0';					/* the flags before the path */
+			flags= path;
+			path= p + 1 + strspn (p + 1, " ");
+		}
+		if (mapOpen (&mf, path) == -1)
+			return Reply (r->fd, "can't open the file", NULL);
+		rc= (pos >= 0 && pos < mf.length) ? server->render (mf.data, mf.length, pos, count, flags, out) : -1;
+		mapClose (&mf);
+		if (rc == -2)
+			return Reply (r->fd, "unknown flag", NULL);
+		if (out->failed)
+			return Reply (r->fd, "not enough memory", NULL);
+		return Reply (r->fd, rc == -1 ? "offset outside the file" : NULL, out);
+	} /* if */
+
+	Reply (r->fd, "unknown request", NULL);
+	return -1;							/* can't tell where the next one starts */
+}
+
+/*
+ * send the text in out, or an error message if msg isn't NULL
+ */
+
+static int Reply (int fd, const char *msg, OutBuf *out) {
+	char	 line[MAXLINE];
+
+	if (msg != NULL)
+		sprintf (line, "ERR %.200s\n", msg);
+	else
+		sprintf (line, "OK %ld\n", out->length);
+	if (WriteFull (fd, line, (long)strlen (line)) == -1)
+		return -1;
+	return (msg == NULL) ? WriteFull (fd, out->data, out->length) : 0;
+}
+
+static int Connect (const char *path) {
+	struct sockaddr_un	 addr;
+	int					 fd;
+
+	if (strlen (path) >= sizeof(addr.sun_path))
+		return -1;
+	memset (&addr, 0, sizeof(addr));
+	addr.sun_family= AF_UNIX;
+	strcpy (addr.sun_path, path);
+	if ((fd= socket (AF_UNIX, SOCK_STREAM, 0)) == -1)
+		return -1;
+	if (connect (fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+		close (fd);
+		return -1;
+	}
+	return fd;
+}
+
+
+/*
+ * reading and writing whole blocks
+ */
+
+static int ReadLine (Reader *r, char *line, long size) {
+	long	 n,
+			 i;
+
+	for (i= 0; i < size - 1; ) {
+		if (r->start == r->end) {
+			if ((n= (long)read (r->fd, r->buf, sizeof(r->buf))) <= 0) {
+				if (n == -1 && errno == EINTR)
+					continue;
+				return -1;
+			}
+			r->start= 0;
+			r->end= n;
+		}
+		if ((line[i]= r->buf[r->start++]) == '\n') {
+			line[i]= '\0';
+			return 0;
+		}
+		i++;
+	}
+	return -1;							/* too long */
+}
+
+static int ReadFull (Reader *r, char *data, long length) {
+	long	 n;
+
+	n= r->end - r->start < length ? r->end - r->start : length;
+	memcpy (data, r->buf + r->start, (size_t)n);
+	r->start+= n;
+	while (n < length) {
+		long	 got;
+
+		if ((got= (long)read (r->fd, data + n, (size_t)(length - n))) <= 0) {
+			if (got == -1 && errno == EINTR)
+				continue;
+			return -1;
+		}
+		n+= got;
+	}
+	return 0;
+}
+
+static int WriteFull (int fd, const char *data, long length) {
+	long	 n;
+
+	while (length > 0) {
+		if ((n= (long)write (fd, data, (size_t)length)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data+= n;
+		length-= n;
+	}
+	return 0;
+}
+
+# endif
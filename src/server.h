@@ -0,0 +1,29 @@
+/*
+ *	server.h
+ *
+ *	Includefile for server.c
+ */
+
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include "vlARGS.h"
+#include "berhdr.h"
+#include "outbuf.h"
+
+/* Answers of srvCall() */
+# define	srvOK			0
+# define	srvERROR		1		/* the server answered with an error	*/
+# define	srvFAILED		-1		/* no connection or broken answer		*/
+
+/*
+ *	Render the elements in data from pos on, count elements or up to the
+ *	end if count is -1, with the flags of the request. Called by the
+ *	threads of the server.
+ */
+typedef int		(*ServeFunc) (const byte *, long, long, long, const char *, OutBuf *);
+
+EXTERN int		 srvServe (const char *, int, ServeFunc);
+EXTERN int		 srvCall (const char *, const char *, const byte *, long, OutBuf *);
+
+#endif
@@ -0,0 +1,356 @@
+/*
+ *	sink.c
+ *
+ *	Write the output, compressed if wanted, on a thread of its own while
+ *	the next output is formatted.
+ */
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	<string.h>
+# include	"stricmp.h"
+# include	"sink.h"
+
+# if defined(__GNUC__) && (defined(__unix__) || defined(__APPLE__)) && !defined(NO_THREADS)
+# define	HAS_THREADS
+# include	<pthread.h>
+# endif
+
+# ifdef HAS_ZLIB
+# include	<zlib.h>
+# endif
+# ifdef HAS_ZSTD
+# include	<zstd.h>
+# endif
+
+# define	ZBUFSIZE		(1L << 17)	/* compressed output per write			*/
+# define	GZIPLEVEL		6
+# define	ZSTDLEVEL		3
+
+struct Sink {
+	FILE			*fp;
+	int				 method;		/* skPLAIN, skGZIP or skZSTD			*/
+	int				 error;			/* a write failed						*/
+	long			 in;			/* bytes of output						*/
+	long			 out;			/* bytes written						*/
+	char			*zbuf;			/* compressed output					*/
+# ifdef HAS_ZLIB
+	z_stream		 z;
+# endif
+# ifdef HAS_ZSTD
+	ZSTD_CCtx		*zstd;
+# endif
+# ifdef HAS_THREADS
+	int				 threaded;
+	pthread_t		 tid;
+	pthread_mutex_t	 lock;			/* for full, busy, stopping and error	*/
+	pthread_cond_t	 cond;
+	OutBuf			 full;			/* handed to the writer					*/
+	int				 busy;			/* full is being written				*/
+	int				 stopping;
+# endif
+};
+
+static int		 Drain (Sink *, int);
+static int		 Put (Sink *, const char *, long);
+static int		 Write (Sink *, const char *, long);
+
+
+/*:>* sink.c ****************************************************************
+
+Name
+	skOpen
+
+Info
+	Write output on a writer thread
+
+Syntax
+	int skMethod (const char *name);
+	Sink *skOpen (FILE *fp, int method);
+	int skFlush (Sink *sink, OutBuf *buf);
+	int skSync (Sink *sink);
+	int skClose (Sink *sink, long *in, long *out);
+
+Include
+	sink.h
+
+Description
+	`skMethod()` returns the compression for `name`: `skPLAIN` for NULL
+	or "none", `skGZIP` for "gzip" and `skZSTD` for "zstd".$
+	`skOpen()` starts a sink which writes to `fp`, compressed with
+	`method`. Where threads are available the writing and compressing is
+	done by a thread of the sink.$
+	`skFlush()` hands the content of `buf` to the sink and leaves `buf`
+	empty. The buffers are swapped rather than copied: `buf` gets the
+	buffer which the writer has finished, so one buffer is filled while
+	the other is compressed and written. If the writer isn't done with the
+	previous buffer yet, the call waits for it.$
+	`skSync()` waits until everything handed to the sink is written and
+	flushes the compressor and `fp`, so a reader of the output sees it
+	all. A compressed stream stays valid, but compresses a little worse
+	with every sync.$
+	`skClose()` writes the rest, ends the compressed stream and releases
+	the sink, `fp` is flushed but not closed. `in` and `out` (if not NULL)
+	get the number of bytes handed to the sink and written to `fp`.
+
+Return value
+	`skMethod()` returns -1 for an unknown name or a compression which
+	isn't compiled in. `skOpen()` returns NULL if there isn't enough
+	memory. `skFlush()`, `skSync()` and `skClose()` return 0 or EOF after
+	a write error.
+
+Example
+	% sink= skOpen (stdout, skMethod ("gzip"));
+	% obPrintf (&out, "%ld\n", value);
+	% skFlush (sink, &out);
+	% skClose (sink, NULL, NULL);
+
+**************************************************************************<:*/
+
+int skMethod (const char *name) {
+	if (name == NULL || stricmp (name, "none") == 0)
+		return skPLAIN;
+# ifdef HAS_ZLIB
+	if (stricmp (name, "gzip") == 0)
+		return skGZIP;
+# endif
+# ifdef HAS_ZSTD
+	if (stricmp (name, "zstd") == 0)
+		return skZSTD;
+# endif
+	return -1;
+}
+
+# ifdef HAS_THREADS
+
+/*
+ * the writer thread, writes one buffer at a time
+ */
+
+static void *Writer (void *arg) {
+	Sink	*s= arg;
+
+	pthread_mutex_lock (&s->lock);
+	for (;;) {
+		while (!s->busy && !s->stopping)
+			pthread_cond_wait (&s->cond, &s->lock);
+		if (!s->busy)
+			break;
+		pthread_mutex_unlock (&s->lock);
+		Put (s, s->full.data, s->full.length);
+		pthread_mutex_lock (&s->lock);
+		s->full.length= 0;
+		s->busy= 0;
+		pthread_cond_broadcast (&s->cond);
+	}
+	pthread_mutex_unlock (&s->lock);
+	return NULL;
+}
+
+# endif
+
+Sink *skOpen (FILE *fp, int method) {
+	Sink	*s;
+
+	if ((s= calloc (1, sizeof(Sink))) == NULL)
+		return NULL;
+	s->fp= fp;
+	s->method= method;
+	if (method != skPLAIN && (s->zbuf= malloc (ZBUFSIZE)) == NULL) {
+		free (s);
+		return NULL;
+	}
+# ifdef HAS_ZLIB
+	if (method == skGZIP && deflateInit2 (&s->z, GZIPLEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		free (s->zbuf);
+		free (s);
+		return NULL;
+	}
+# endif
+# ifdef HAS_ZSTD
+	if (method == skZSTD) {
+		if ((s->zstd= ZSTD_createCCtx ()) == NULL) {
+			free (s->zbuf);
+			free (s);
+			return NULL;
+		}
+		ZSTD_CCtx_setParameter (s->zstd, ZSTD_c_compressionLevel, ZSTDLEVEL);
+	}
+# endif
+# ifdef HAS_THREADS
+	obInit (&s->full);
+	pthread_mutex_init (&s->lock, NULL);
+	pthread_cond_init (&s->cond, NULL);
+	s->threaded= pthread_create (&s->tid, NULL, Writer, s) == 0;
+# endif
+	return s;
+}
+
+int skFlush (Sink *s, OutBuf *buf) {
+# ifdef HAS_THREADS
+	OutBuf	 empty;
+	int		 error;
+
+	if (s->threaded) {
+		if (buf->length == 0)
+			return 0;
+		pthread_mutex_lock (&s->lock);
+		while (s->busy)
+			pthread_cond_wait (&s->cond, &s->lock);
+		empty= s->full;
+		s->full= *buf;
+		*buf= empty;
+		s->busy= 1;
+		pthread_cond_broadcast (&s->cond);
+		error= s->error;
+		pthread_mutex_unlock (&s->lock);
+		return error ? EOF : 0;
+	} /* if */
+# endif
+	Put (s, buf->data, buf->length);
+	buf->length= 0;
+	return s->error ? EOF : 0;
+}
+
+int skSync (Sink *s) {
+# ifdef HAS_THREADS
+	if (s->threaded) {
+		pthread_mutex_lock (&s->lock);
+		while (s->busy)
+			pthread_cond_wait (&s->cond, &s->lock);
+		pthread_mutex_unlock (&s->lock);
+	}
+# endif
+	Drain (s, 0);						/* the writer waits for the next buffer */
+	if (fflush (s->fp) == EOF)
+		s->error= 1;
+	return s->error ? EOF : 0;
+}
+
+int skClose (Sink *s, long *in, long *out) {
+	int		 rc;
+
+# ifdef HAS_THREADS
+	if (s->threaded) {
+		pthread_mutex_lock (&s->lock);
+		s->stopping= 1;
+		pthread_cond_broadcast (&s->cond);
+		pthread_mutex_unlock (&s->lock);
+		pthread_join (s->tid, NULL);
+	}
+	pthread_mutex_destroy (&s->lock);
+	pthread_cond_destroy (&s->cond);
+	obFree (&s->full);
+# endif
+	Drain (s, 1);
+# ifdef HAS_ZLIB
+	if (s->method == skGZIP)
+		deflateEnd (&s->z);
+# endif
+# ifdef HAS_ZSTD
+	if (s->method == skZSTD)
+		ZSTD_freeCCtx (s->zstd);
+# endif
+	if (fflush (s->fp) == EOF)
+		s->error= 1;
+	if (in != NULL)
+		*in= s->in;
+	if (out != NULL)
+		*out= s->out;
+	rc= s->error ? EOF : 0;
+	free (s->zbuf);
+	free (s);
+	return rc;
+}
+
+
+/*
+ * compress and write data, on the writer thread
+ */
+
+static int Put (Sink *s, const char *data, long length) {
+	s->in+= length;
+	switch (s->method) {
+# ifdef HAS_ZLIB
+		case skGZIP:
+			s->z.next_in= (Bytef *)data;
+			s->z.avail_in= (uInt)length;
+			do {
+				s->z.next_out= (Bytef *)s->zbuf;
+				s->z.avail_out= ZBUFSIZE;
+				deflate (&s->z, Z_NO_FLUSH);
+				Write (s, s->zbuf, ZBUFSIZE - (long)s->z.avail_out);
+			} while (s->z.avail_out == 0);
+			break;
+# endif
+# ifdef HAS_ZSTD
+		case skZSTD: {
+			ZSTD_inBuffer	 zin;
+			ZSTD_outBuffer	 zout;
+
+			zin.src= data;
+			zin.size= (size_t)length;
+			zin.pos= 0;
+			while (zin.pos < zin.size) {
+				zout.dst= s->zbuf;
+				zout.size= ZBUFSIZE;
+				zout.pos= 0;
+				if (ZSTD_isError (ZSTD_compressStream2 (s->zstd, &zout, &zin, ZSTD_e_continue))) {
+					s->error= 1;
+					break;
+				}
+				Write (s, s->zbuf, (long)zout.pos);
+			}
+			break;
+		}
+# endif
+		default:
+			Write (s, data, length);
+	}
+	return s->error ? EOF : 0;
+}
+
+/*
+ * write what the compressor holds back, and end the stream if end is set
+ */
+
+static int Drain (Sink *s, int end) {
+# ifdef HAS_ZLIB
+	int		 rc;
+
+	if (s->method == skGZIP) {
+		s->z.avail_in= 0;
+		do {
+			s->z.next_out= (Bytef *)s->zbuf;
+			s->z.avail_out= ZBUFSIZE;
+			rc= deflate (&s->z, end ? Z_FINISH : Z_SYNC_FLUSH);
+			Write (s, s->zbuf, ZBUFSIZE - (long)s->z.avail_out);
+		} while (end ? rc == Z_OK : s->z.avail_out == 0);
+	}
+# endif
+# ifdef HAS_ZSTD
+	if (s->method == skZSTD) {
+		ZSTD_inBuffer	 zin;
+		ZSTD_outBuffer	 zout;
+		size_t			 left;
+
+		zin.src= NULL;
+		zin.size= zin.pos= 0;
+		do {
+			zout.dst= s->zbuf;
+			zout.size= ZBUFSIZE;
+			zout.pos= 0;
+			left= ZSTD_compressStream2 (s->zstd, &zout, &zin, end ? ZSTD_e_end : ZSTD_e_flush);
+			Write (s, s->zbuf, (long)zout.pos);
+		} while (left != 0 && !ZSTD_isError (left));
+	}
+# endif
+	return s->error ? EOF : 0;
+}
+
+static int Write (Sink *s, const char *data, long length) {
+	if (length > 0 && fwrite (data, 1, (size_t)length, s->fp) != (size_t)length)
+		s->error= 1;
+	s->out+= length;
+	return s->error ? EOF : 0;
+}
@@ -0,0 +1,27 @@
+/*
+ *	sink.h
+ *
+ *	Includefile for sink.c
+ */
+
+#ifndef __SINK_H__
+#define __SINK_H__
+
+#include <stdio.h>
+#include "vlARGS.h"
+#include "outbuf.h"
+
+/* Compression of the output */
+# define	skPLAIN			0
+# define	skGZIP			1		/* needs HAS_ZLIB						*/
+# define	skZSTD			2		/* needs HAS_ZSTD						*/
+
+typedef struct Sink Sink;
+
+EXTERN int		 skMethod (const char *);
+EXTERN Sink		*skOpen (FILE *, int);
+EXTERN int		 skFlush (Sink *, OutBuf *);
+EXTERN int		 skSync (Sink *);
+EXTERN int		 skClose (Sink *, long *, long *);
+
+#endif
@@ -0,0 +1,400 @@
+/*
+ *	tlvtree.c
+ *
+ *	Build a compact TLV tree of a BER element in a single pass over the
+ *	data. Only headers are decoded here, see berval.c for the values.
+ */
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	<string.h>
+# include	"endcache.h"
+# include	"tlvtree.h"
+
+
+static int	 Grow (TlvTree *);
+static int	 GrowStack (TlvTree *);
+static long	 AddNode (TlvTree *, long, long, long, BerHeader *);
+static long	 End (TlvTree *, long, long);
+
+
+/*:>* tlvtree.c *************************************************************
+
+Name
+	tlvInit
+
+Info
+	Initialize a TLV tree
+
+Syntax
+	void tlvInit (TlvTree *tree, const byte *data, long length);
+
+Include
+	tlvtree.h
+
+Description
+	`tlvInit()` prepares `tree` for parsing elements from `data`, which
+	is `length` bytes long, without limits (see tlvParse). `tlvReset()`
+	removes all nodes and everything else allocated from the arena of the
+	tree, `tlvFree()` returns the memory to the system.
+
+See also
+	tlvParse
+
+**************************************************************************<:*/
+
+void tlvInit (TlvTree *t, const byte *data, long length) {
+	memset (t, 0, sizeof(TlvTree));
+	t->data= data;
+	t->dlength= length;
+	t->cutpos= -1;
+	arenaInit (&t->arena, 0);
+}
+
+void tlvReset (TlvTree *t) {
+	if (t->count > t->maxcount)
+		t->maxcount= t->count;
+	t->count= 0;
+	t->size= 0;
+	t->stacksize= 0;
+	t->cutpos= -1;
+	arenaReset (&t->arena);
+}
+
+void tlvFree (TlvTree *t) {
+	arenaFree (&t->arena);
+	tlvInit (t, t->data, t->dlength);
+}
+
+
+/*:>* tlvtree.c *************************************************************
+
+Name
+	tlvParse
+
+Info
+	Add one BER element and all its descendants to the tree
+
+Syntax
+	long tlvParse (TlvTree *tree, long pos, long limit, long parent, int strict);
+
+Include
+	tlvtree.h
+
+Description
+	`tlvParse()` parses the element at offset `pos` of the tree data and
+	adds it as the last child of `parent` (-1 for a root element). The data
+	is walked iteratively, so deeply nested input doesn't exhaust the stack.$
+	No element may extend beyond `limit`. Unless `strict` is set, an
+	element may extend beyond the end of its parent (the rest of the parent
+	is then taken from behind the element), and an end-of-contents octet
+	pair outside of an indefinite length element is skipped as padding.$
+	`maxdepth` and `maxnodes` of the tree bound the work on pathological
+	input. The content of a constructed element on level `maxdepth` (1 for
+	a root element) isn't parsed, its `child` is set to `tlvSKIPPED`. When
+	the tree holds `maxnodes` nodes, the rest of the root element isn't
+	parsed and `cutpos` is set to where parsing stopped. In both cases the
+	content is skipped by its length; the end of an indefinite length
+	element is found from the headers only (see ecFindEnd). With a
+	`parent` the element isn't cut by `maxnodes`, `tlvEOF` is returned
+	instead.
+
+Return value
+	The function returns the offset behind the element, `tlvEOF` if there
+	is no complete element at `pos`, `tlvERROR` if an invalid length was
+	encountered or `tlvNOMEM` if there isn't enough memory for the nodes.
+	For `tlvERROR` `errpos` and `errlen` of the tree are set. If an
+	element was started but the data ends inside it, `errpos` is set to
+	the innermost element which isn't complete. The nodes parsed so far
+	stay in the tree in all cases.
+
+See also
+	tlvParseContent
+
+**************************************************************************<:*/
+
+long tlvParse (TlvTree *t, long pos, long limit, long parent, int strict) {
+	BerHeader	 hdr;
+	long		 sp,
+				 top,
+				 last,
+				 node,
+				 depth,
+				 end,
+				 rc;
+	int			 started,
+				 status;
+
+	sp= 0;
+	top= parent;
+	started= 0;
+	rc= tlvEOF;
+	for (depth= 1, node= parent; node != -1; node= t->parent[node])
+		depth++;
+
+	/* find the last child of parent, the new element is appended to it */
+	last= (parent != -1) ? t->child[parent] : -1;
+	while (last != -1 && t->next[last] != -1)
+		last= t->next[last];
+
+	for (;;) {
+		if (sp > 0) {
+			top= t->stack[sp - 1];
+			if (t->length[top] != -1 && pos >= tlvContentOffset (t, top) + t->length[top]) {
+				t->end[top]= pos;
+				last= top;
+				sp--;
+				continue;
+			}
+		} else if (started)
+			return pos;
+
+		if (pos >= limit) {
+			if (sp > 0)
+				t->errpos= t->offset[top];	/* an indefinite length element isn't terminated */
+			rc= tlvEOF;
+			break;
+		}
+		if ((status= berReadHeader (t->data + pos, limit - pos, &hdr)) < 0) {
+			if (status == berBADLENGTH) {
+				t->errpos= pos + 1;
+				t->errlen= -1;
+				rc= tlvERROR;
+			} else {
+				t->errpos= pos;
+				rc= tlvEOF;
+			}
+			break;
+		}
+
+		if (berIsEOC (&hdr)) {
+			if (sp > 0 && !(strict && t->length[top] != -1)) {
+				pos+= 2;
+				t->end[top]= pos;
+				last= top;
+				sp--;
+				continue;
+			}
+			if (!strict && !started)
+				return pos + 2;			/* padding between elements */
+			t->errpos= pos + 1;
+			t->errlen= 0;
+			rc= tlvERROR;
+			break;
+		}
+
+		if (hdr.length > limit - pos - hdr.hdrlen ||
+			(hdr.length == -1 && hdr.pc == berPRIMITIVE)) {
+			t->errpos= pos + hdr.taglen;
+			t->errlen= hdr.length;
+			rc= tlvERROR;
+			break;
+		}
+
+		if (t->maxnodes > 0 && t->count >= t->maxnodes && started) {
+			if (parent != -1)
+				break;					/* tlvEOF */
+			/* skip the rest of all open elements */
+			t->cutpos= pos;
+			while (sp > 0) {
+				top= t->stack[--sp];
+				if ((end= End (t, top, limit)) < 0)
+					break;
+				t->end[top]= pos= end;
+			}
+			if (end < 0) {
+				rc= end;
+				break;
+			}
+			return pos;
+		}
+
+		if ((node= AddNode (t, pos, (sp > 0) ? top : parent, last, &hdr)) == -1) {
+			rc= tlvNOMEM;
+			break;
+		}
+		started= 1;
+		pos+= hdr.hdrlen;
+
+		if (hdr.pc == berCONSTRUCTED && t->maxdepth > 0 && depth + sp >= t->maxdepth) {
+			/* too deep, skip the content */
+			if ((end= End (t, node, limit)) < 0) {
+				rc= end;
+				break;
+			}
+			t->child[node]= tlvSKIPPED;
+			t->end[node]= pos= end;
+			last= node;
+		} else if (hdr.pc == berCONSTRUCTED) {
+			if (sp >= t->stacksize && GrowStack (t) == -1) {
+				rc= tlvNOMEM;
+				break;
+			}
+			t->stack[sp++]= node;
+			last= -1;
+		} else {
+			pos+= hdr.length;
+			t->end[node]= pos;
+			last= node;
+		}
+	}
+
+	/* Error or truncated: close all elements which are still open */
+	while (sp > 0)
+		t->end[t->stack[--sp]]= pos;
+	return rc;
+}
+
+
+/*:>* tlvtree.c *************************************************************
+
+Name
+	tlvParseContent
+
+Info
+	Try to parse the content of a primitive element as BER elements
+
+Syntax
+	int tlvParseContent (TlvTree *tree, long node);
+
+Include
+	tlvtree.h
+
+Description
+	`tlvParseContent()` parses the content of `node` strictly as a
+	sequence of BER elements and adds them as children of `node`. This
+	is used to look into context-specific tags which carry an encoded
+	value in a primitive element. If the content doesn't consist of
+	complete elements the tree is left unchanged.
+
+Return value
+	The function returns 0 if the content could be parsed or -1 otherwise.
+
+See also
+	tlvParse
+
+**************************************************************************<:*/
+
+int tlvParseContent (TlvTree *t, long node) {
+	long	 count,
+			 pos,
+			 end;
+
+	if (t->child[node] != -1)		/* already done */
+		return 0;
+
+	count= t->count;
+	pos= tlvContentOffset (t, node);
+	end= pos + tlvContentLength (t, node);
+	while (pos < end && pos >= 0)
+		pos= tlvParse (t, pos, end, node, 1);
+
+	if (pos != end || count == t->count) {
+		t->count= count;			/* roll back */
+		t->child[node]= -1;
+		return -1;
+	}
+	return 0;
+}
+
+
+/****************************************************************************/
+
+static long AddNode (TlvTree *t, long pos, long parent, long prev, BerHeader *hdr) {
+	long	 n;
+
+	if (t->count >= t->size && Grow (t) == -1)
+		return -1;
+
+	n= t->count++;
+	t->offset[n]= pos;
+	t->length[n]= hdr->length;
+	t->end[n]= pos + hdr->hdrlen + hdr->length;
+	t->tag[n]= hdr->tag;
+	t->clpc[n]= (byte)((hdr->cl << 1) | hdr->pc);
+	t->taglen[n]= (byte)hdr->taglen;
+	t->hdrlen[n]= (byte)hdr->hdrlen;
+	t->parent[n]= parent;
+	t->child[n]= -1;
+	t->next[n]= -1;
+
+	if (prev != -1)
+		t->next[prev]= n;
+	else if (parent != -1)
+		t->child[parent]= n;
+	return n;
+}
+
+
+/*
+ *	End of the content of node, from its length or by its headers. Returns
+ *	tlvEOF if it is truncated, tlvERROR if it contains an invalid length.
+ */
+
+static long End (TlvTree *t, long node, long limit) {
+	long	 end;
+
+	if (t->length[node] != -1)
+		return tlvContentOffset (t, node) + t->length[node];
+	if ((end= ecFindEnd (NULL, t->data, limit, t->offset[node])) == berBADLENGTH) {
+		t->errpos= t->offset[node] + t->taglen[node];
+		t->errlen= -1;
+		return tlvERROR;
+	}
+	if (end < 0) {
+		t->errpos= t->offset[node];
+		return tlvEOF;
+	}
+	return end;
+}
+
+
+/*
+ *	The node arrays are taken from the arena. When they are full, larger
+ *	ones are allocated and the old ones are left to the next reset. The
+ *	first allocation after a reset is sized for the largest element seen
+ *	so far, so usually no copying happens at all.
+ */
+
+# define	GROW(p,type,n)	{ type *tmp= arenaAlloc (&t->arena, (n) * sizeof(type)); \
+							  if (tmp == NULL) return -1; \
+							  if (p) memcpy (tmp, p, t->count * sizeof(type)); \
+							  p= tmp; }
+
+static int Grow (TlvTree *t) {
+	long	 n;
+
+	if (t->size == 0) {
+		n= (t->maxcount > 1024) ? t->maxcount : 1024;
+		t->offset= t->length= t->end= t->tag= NULL;
+		t->clpc= t->taglen= t->hdrlen= NULL;
+		t->parent= t->child= t->next= NULL;
+	} else
+		n= t->size * 2;
+	GROW (t->offset, long, n);
+	GROW (t->length, long, n);
+	GROW (t->end,    long, n);
+	GROW (t->tag,    long, n);
+	GROW (t->clpc,   byte, n);
+	GROW (t->taglen, byte, n);
+	GROW (t->hdrlen, byte, n);
+	GROW (t->parent, long, n);
+	GROW (t->child,  long, n);
+	GROW (t->next,   long, n);
+	t->size= n;
+	return 0;
+}
+
+static int GrowStack (TlvTree *t) {
+	long	*tmp;
+	long	 n;
+
+	n= (t->stacksize > 0) ? t->stacksize * 2 : 64;
+	if ((tmp= arenaAlloc (&t->arena, n * sizeof(long))) == NULL)
+		return -1;
+	if (t->stacksize > 0)
+		memcpy (tmp, t->stack, t->stacksize * sizeof(long));
+	t->stack= tmp;
+	t->stacksize= n;
+	return 0;
+}
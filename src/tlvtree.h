@@ -0,0 +1,75 @@
+/*
+ *	tlvtree.h
+ *
+ *	Includefile for tlvtree.c
+ */
+
+#ifndef __TLVTREE_H__
+#define __TLVTREE_H__
+
+#include "vlARGS.h"
+#include "berhdr.h"
+#include "arena.h"
+
+/* Return values of tlvParse() */
+# define	tlvEOF			-1		/* no further (complete) element		*/
+# define	tlvERROR		-2		/* unexpected length, see errpos/errlen	*/
+# define	tlvNOMEM		-3		/* not enough memory for the nodes		*/
+
+/* child of a constructed node whose content wasn't parsed (maxdepth) */
+# define	tlvSKIPPED		-2
+
+/*
+ *	The TLV tree of one element. The nodes are stored as a structure of
+ *	arrays, indexed by the node number. Nodes are numbered in the order
+ *	of their appearance in the data, so node 0 is the root element. Only
+ *	the headers are decoded while building the tree, the values are left
+ *	in the data until a renderer asks for them.
+ *	All memory of the tree, and of values decoded by a renderer, is taken
+ *	from the arena and released at once by tlvReset().
+ */
+typedef struct {
+	const byte	*data;			/* the data the offsets refer to		*/
+	long		 dlength;		/* length of the data					*/
+
+	long		 count;			/* number of nodes						*/
+	long		 size;			/* number of allocated nodes			*/
+	long		*offset;		/* offset of the identifier octets		*/
+	long		*length;		/* content length, -1 if indefinite		*/
+	long		*end;			/* offset behind the element (incl. EOC)*/
+	long		*tag;			/* tag number							*/
+	byte		*clpc;			/* class << 1 | pc						*/
+	byte		*taglen;		/* number of identifier octets			*/
+	byte		*hdrlen;		/* number of identifier + length octets	*/
+	long		*parent;		/* parent node or -1					*/
+	long		*child;			/* first child node or -1				*/
+	long		*next;			/* next sibling node or -1				*/
+
+	long		*stack;			/* open constructed nodes while parsing	*/
+	long		 stacksize;
+
+	Arena		 arena;			/* memory of nodes and decoded values	*/
+	long		 maxcount;		/* largest number of nodes so far		*/
+
+	long		 errpos;		/* position of a bad length field		*/
+	long		 errlen;		/* the bad length						*/
+
+	long		 maxdepth;		/* levels parsed, 0 for all				*/
+	long		 maxnodes;		/* nodes per element, 0 for all			*/
+	long		 cutpos;		/* where maxnodes stopped, -1 if not	*/
+} TlvTree;
+
+# define	tlvClass(t,n)			((t)->clpc[n] >> 1)
+# define	tlvPc(t,n)				((t)->clpc[n] & 1)
+# define	tlvContentOffset(t,n)	((t)->offset[n] + (t)->hdrlen[n])
+# define	tlvContent(t,n)			((t)->data + tlvContentOffset(t,n))
+# define	tlvContentLength(t,n)	((t)->length[n] != -1 ? (t)->length[n] : \
+										(t)->end[n] - tlvContentOffset(t,n) - 2)
+
+EXTERN void		 tlvInit (TlvTree *, const byte *, long);
+EXTERN void		 tlvReset (TlvTree *);
+EXTERN void		 tlvFree (TlvTree *);
+EXTERN long		 tlvParse (TlvTree *, long, long, long, int);
+EXTERN int		 tlvParseContent (TlvTree *, long);
+
+#endif
@@ -0,0 +1,504 @@
+/*
+ *	workpool.c
+ *
+ *	Work-stealing pool of threads for tasks whose output has to be
+ *	written in order.
+ */
+
+# include	<stdlib.h>
+# include	<stdio.h>
+# include	<string.h>
+# include	"workpool.h"
+
+# ifdef HAS_THREADS
+# include	<pthread.h>
+# include	<time.h>
+
+/*
+ *	Deque of a worker: the worker takes its own tasks from the bottom,
+ *	others steal from the top
+ */
+typedef struct {
+	pthread_mutex_t	 lock;
+	WpTask			**task;			/* ring of tasks, size is a power of 2	*/
+	long			 size;
+	long			 top;			/* oldest task							*/
+	long			 bottom;		/* behind the newest task				*/
+} Deque;
+
+typedef struct {
+	WorkPool		*pool;
+	int				 index;
+	pthread_t		 tid;
+	Deque			 deque;
+	long			 tasks;			/* statistics							*/
+	long			 steals;
+	double			 busy;			/* seconds spent in tasks				*/
+} Worker;
+
+struct WorkPool {
+	int				 threads;
+	TaskFunc		 run;
+	Worker			*worker;
+	pthread_mutex_t	 lock;			/* for all of the following				*/
+	pthread_cond_t	 work;			/* tasks were pushed					*/
+	pthread_cond_t	 done;			/* a task is done						*/
+	WpTask			*head;			/* next task to write					*/
+	WpTask			*tail;
+	long			 pending;		/* tasks not written yet				*/
+	long			 queued;		/* tasks in the deques					*/
+	WpTask			*free;			/* written tasks for reuse				*/
+	int				 inject;		/* next worker for tasks of the writer	*/
+	int				 stopping;
+	double			 started;
+};
+
+static THREAD_LOCAL Worker	*self= NULL;	/* the worker of this thread */
+
+static WpTask	*PopBottom (Deque *);
+static WpTask	*PopTop (Deque *);
+static int		 Push (Deque *, WpTask *, int);
+static void		*Run (void *);
+static double	 Now (void);
+
+
+/*:>* workpool.c ************************************************************
+
+Name
+	wpCreate
+
+Info
+	Start a work-stealing pool of threads
+
+Syntax
+	WorkPool *wpCreate (int threads, TaskFunc run);
+	void wpDestroy (WorkPool *pool);
+
+Include
+	workpool.h
+
+Description
+	`wpCreate()` starts `threads` workers which call `run(pool, task)`
+	for the tasks pushed to the pool. Each worker has a deque of tasks.
+	It runs the newest task of its own deque first, so the subtasks of a
+	task are run by the same thread while their data is in its caches.
+	A worker without tasks steals the oldest task of another worker,
+	so big tasks, or tasks split into many subtasks, keep all threads
+	busy however uneven the tasks are. Before a worker ends it calls
+	`run(pool, NULL)`, so what the task function keeps per thread can be
+	released.$
+	`wpDestroy()` stops the workers, tasks which haven't been run yet
+	are dropped, and releases the pool.
+
+Return value
+	`wpCreate()` returns the pool or NULL if the threads can't be started
+	or there is no thread support.
+
+See also
+	wpSpawn, wpWrite
+
+**************************************************************************<:*/
+
+WorkPool *wpCreate (int threads, TaskFunc run) {
+	WorkPool	*pool;
+	int			 i;
+
+	if ((pool= calloc (1, sizeof(WorkPool))) == NULL ||
+		(pool->worker= calloc ((size_t)threads, sizeof(Worker))) == NULL) {
+		free (pool);
+		return NULL;
+	}
+	pool->threads= threads;
+	pool->run= run;
+	pool->started= Now ();
+	pthread_mutex_init (&pool->lock, NULL);
+	pthread_cond_init (&pool->work, NULL);
+	pthread_cond_init (&pool->done, NULL);
+	for (i= 0; i < threads; i++) {
+		pool->worker[i].pool= pool;
+		pool->worker[i].index= i;
+		pthread_mutex_init (&pool->worker[i].deque.lock, NULL);
+	}
+	for (i= 0; i < threads; i++)
+		if (pthread_create (&pool->worker[i].tid, NULL, Run, &pool->worker[i]) != 0) {
+			pool->threads= i;
+			wpDestroy (pool);
+			return NULL;
+		}
+	return pool;
+}
+
+void wpDestroy (WorkPool *pool) {
+	WpTask	*t;
+	int		 i;
+
+	pthread_mutex_lock (&pool->lock);
+	pool->stopping= 1;
+	pthread_cond_broadcast (&pool->work);
+	pthread_mutex_unlock (&pool->lock);
+	for (i= 0; i < pool->threads; i++)
+		pthread_join (pool->worker[i].tid, NULL);
+
+	while ((t= pool->head) != NULL || (t= pool->free) != NULL) {
+		if (t == pool->head)
+			pool->head= t->next;
+		else
+			pool->free= t->next;
+		obFree (&t->out);
+		free (t);
+	}
+	for (i= 0; i < pool->threads; i++) {
+		pthread_mutex_destroy (&pool->worker[i].deque.lock);
+		free (pool->worker[i].deque.task);
+	}
+	pthread_cond_destroy (&pool->done);
+	pthread_cond_destroy (&pool->work);
+	pthread_mutex_destroy (&pool->lock);
+	free (pool->worker);
+	free (pool);
+}
+
+
+/*:>* workpool.c ************************************************************
+
+Name
+	wpSpawn
+
+Info
+	Create and push tasks
+
+Syntax
+	WpTask *wpSpawn (WorkPool *pool, WpTask *after, int kind,
+					 long arg0, long arg1, long arg2, long arg3);
+	int wpPush (WorkPool *pool, WpTask *task);
+	void wpCancel (WorkPool *pool, WpTask *task);
+
+Include
+	workpool.h
+
+Description
+	`wpSpawn()` creates a task with the given `kind` and arguments. Its
+	output is placed right behind that of the task `after`, or at the
+	end if `after` is NULL. A task splitting its work passes itself as
+	`after` for the first subtask, and each subtask for the next one.$
+	`wpPush()` makes the task available to the workers. Called by a
+	worker, the task goes to the bottom of its own deque, otherwise the
+	task is handed to the workers in turn. `wpCancel()` takes a task which
+	was spawned but won't be pushed as done, with no output.
+
+Return value
+	`wpSpawn()` returns the new task or NULL if there isn't enough memory.
+	`wpPush()` returns 0, or -1 if there isn't enough memory for the task
+	in a deque. The task stays in the output, so it has to be taken back
+	with wpCancel(), or no further tasks should be added and the output
+	should not be written.
+
+See also
+	wpCreate, wpWrite
+
+**************************************************************************<:*/
+
+WpTask *wpSpawn (WorkPool *pool, WpTask *after, int kind, long arg0, long arg1, long arg2, long arg3) {
+	WpTask	*t;
+
+	pthread_mutex_lock (&pool->lock);
+	if ((t= pool->free) != NULL)
+		pool->free= t->next;
+	else if ((t= calloc (1, sizeof(WpTask))) == NULL) {
+		pthread_mutex_unlock (&pool->lock);
+		return NULL;
+	}
+	t->kind= kind;
+	t->arg[0]= arg0;
+	t->arg[1]= arg1;
+	t->arg[2]= arg2;
+	t->arg[3]= arg3;
+	t->status= wpCONTINUE;
+	t->done= 0;
+	t->out.length= 0;
+	t->out.failed= 0;
+
+	if (after == NULL)
+		after= pool->tail;
+	if (after == NULL) {
+		t->next= NULL;
+		pool->head= t;
+	} else {
+		t->next= after->next;
+		after->next= t;
+	}
+	if (t->next == NULL)
+		pool->tail= t;
+	pool->pending++;
+	pthread_mutex_unlock (&pool->lock);
+	return t;
+}
+
+int wpPush (WorkPool *pool, WpTask *t) {
+	Worker	*w;
+	int		 rc;
+
+	if (self != NULL && self->pool == pool)
+		rc= Push (&self->deque, t, 1);
+	else {
+		pthread_mutex_lock (&pool->lock);
+		w= &pool->worker[pool->inject];
+		pool->inject= (pool->inject + 1) % pool->threads;
+		pthread_mutex_unlock (&pool->lock);
+		rc= Push (&w->deque, t, 0);
+	}
+
+	if (rc == -1)				/* no room in the deque */
+		return -1;
+	pthread_mutex_lock (&pool->lock);
+	pool->queued++;
+	pthread_cond_signal (&pool->work);
+	pthread_mutex_unlock (&pool->lock);
+	return 0;
+}
+
+void wpCancel (WorkPool *pool, WpTask *t) {
+	pthread_mutex_lock (&pool->lock);
+	t->done= 1;
+	pthread_cond_signal (&pool->done);
+	pthread_mutex_unlock (&pool->lock);
+}
+
+
+/*:>* workpool.c ************************************************************
+
+Name
+	wpWrite
+
+Info
+	Write the output of done tasks in order
+
+Syntax
+	int wpWrite (WorkPool *pool, Sink *sink, long keep);
+
+Include
+	workpool.h
+
+Description
+	`wpWrite()` hands the output of the tasks to `sink`, in the order given
+	by wpSpawn(), as far as the tasks are done. If more than `keep` tasks
+	are left it waits for them, so the writer can limit the tasks ahead
+	of the output. With `keep` 0 all tasks are written.$
+	The output ends with a task whose status was set to `wpSTOP`,
+	`wpERROR` or `wpNOMEM` by the task function.
+
+Return value
+	The function returns `wpCONTINUE`, or the status of the task the
+	output ended with. Then no further tasks should be added.
+
+See also
+	wpSpawn
+
+**************************************************************************<:*/
+
+int wpWrite (WorkPool *pool, Sink *sink, long keep) {
+	WpTask	*t;
+	int		 status;
+
+	status= wpCONTINUE;
+	pthread_mutex_lock (&pool->lock);
+	while ((t= pool->head) != NULL && status == wpCONTINUE) {
+		if (!t->done) {
+			if (pool->pending <= keep)
+				break;
+			pthread_cond_wait (&pool->done, &pool->lock);
+			continue;
+		}
+		pthread_mutex_unlock (&pool->lock);
+		skFlush (sink, &t->out);
+		status= t->status;
+		pthread_mutex_lock (&pool->lock);
+		if ((pool->head= t->next) == NULL)
+			pool->tail= NULL;
+		pool->pending--;
+		t->next= pool->free;
+		pool->free= t;
+	}
+	pthread_mutex_unlock (&pool->lock);
+	return status;
+}
+
+
+/*:>* workpool.c ************************************************************
+
+Name
+	wpThreadStats
+
+Info
+	Get the statistics of a worker
+
+Syntax
+	int wpThreadStats (WorkPool *pool, int i, long *tasks, long *steals,
+					   double *busy);
+
+Include
+	workpool.h
+
+Description
+	`wpThreadStats()` returns the number of tasks run by the worker `i`,
+	how many of them were stolen from other workers, and the share of
+	the time since wpCreate() the worker spent in tasks (0.0 .. 1.0).
+
+Return value
+	The function returns 0 or -1 if there is no worker `i`.
+
+**************************************************************************<:*/
+
+int wpThreadStats (WorkPool *pool, int i, long *tasks, long *steals, double *busy) {
+	double	 elapsed;
+
+	if (i < 0 || i >= pool->threads)
+		return -1;
+	pthread_mutex_lock (&pool->lock);
+	*tasks= pool->worker[i].tasks;
+	*steals= pool->worker[i].steals;
+	elapsed= Now () - pool->started;
+	*busy= elapsed > 0 ? pool->worker[i].busy / elapsed : 0.0;
+	pthread_mutex_unlock (&pool->lock);
+	return 0;
+}
+
+
+/*
+ * the loop of a worker
+ */
+
+static void *Run (void *p) {
+	WorkPool	*pool;
+	WpTask		*t;
+	double		 start;
+	int			 i,
+				 stolen;
+
+	self= p;
+	pool= self->pool;
+	for (;;) {
+		stolen= 0;
+		if ((t= PopBottom (&self->deque)) == NULL)
+			for (i= 1; i < pool->threads && t == NULL; i++)
+				if ((t= PopTop (&pool->worker[(self->index + i) % pool->threads].deque)) != NULL)
+					stolen= 1;
+
+		pthread_mutex_lock (&pool->lock);
+		if (t == NULL) {
+			if (pool->stopping)
+				break;
+			if (pool->queued == 0)
+				pthread_cond_wait (&pool->work, &pool->lock);
+			pthread_mutex_unlock (&pool->lock);
+			continue;
+		}
+		pool->queued--;
+		if (pool->stopping) {		/* drop it */
+			pthread_mutex_unlock (&pool->lock);
+			continue;
+		}
+		pthread_mutex_unlock (&pool->lock);
+
+		start= Now ();
+		pool->run (pool, t);
+
+		pthread_mutex_lock (&pool->lock);
+		self->busy+= Now () - start;
+		self->tasks++;
+		self->steals+= stolen;
+		t->done= 1;
+		pthread_cond_signal (&pool->done);
+		pthread_mutex_unlock (&pool->lock);
+	}
+	pthread_mutex_unlock (&pool->lock);
+	pool->run (pool, NULL);			/* release the state of the thread */
+	return NULL;
+}
+
+
+/*
+ * deque operations
+ */
+
+static int Push (Deque *d, WpTask *t, int bottom) {
+	WpTask	**task;
+	long	 i,
+			 size;
+
+	pthread_mutex_lock (&d->lock);
+	if (d->bottom - d->top == d->size) {		/* full, double it */
+		size= d->size ? 2 * d->size : 64;
+		if ((task= malloc (size * sizeof(WpTask *))) == NULL) {
+			pthread_mutex_unlock (&d->lock);
+			return -1;
+		}
+		for (i= d->top; i < d->bottom; i++)
+			task[i & (size - 1)]= d->task[i & (d->size - 1)];
+		free (d->task);
+		d->task= task;
+		d->size= size;
+	}
+	if (bottom)
+		d->task[d->bottom++ & (d->size - 1)]= t;
+	else
+		d->task[--d->top & (d->size - 1)]= t;
+	pthread_mutex_unlock (&d->lock);
+	return 0;
+}
+
+static WpTask *PopBottom (Deque *d) {
+	WpTask	*t;
+
+	pthread_mutex_lock (&d->lock);
+	t= (d->bottom > d->top) ? d->task[--d->bottom & (d->size - 1)] : NULL;
+	pthread_mutex_unlock (&d->lock);
+	return t;
+}
+
+static WpTask *PopTop (Deque *d) {
+	WpTask	*t;
+
+	pthread_mutex_lock (&d->lock);
+	t= (d->bottom > d->top) ? d->task[d->top++ & (d->size - 1)] : NULL;
+	pthread_mutex_unlock (&d->lock);
+	return t;
+}
+
+static double Now (void) {
+	struct timespec	 ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+# else		/* no threads */
+
+WorkPool *wpCreate (int threads, TaskFunc run) {
+	return NULL;
+}
+
+WpTask *wpSpawn (WorkPool *pool, WpTask *after, int kind, long arg0, long arg1, long arg2, long arg3) {
+	return NULL;
+}
+
+int wpPush (WorkPool *pool, WpTask *t) {
+	return -1;
+}
+
+void wpCancel (WorkPool *pool, WpTask *t) {
+}
+
+int wpWrite (WorkPool *pool, Sink *sink, long keep) {
+	return wpCONTINUE;
+}
+
+void wpDestroy (WorkPool *pool) {
+}
+
+int wpThreadStats (WorkPool *pool, int i, long *tasks, long *steals, double *busy) {
+	return -1;
+}
+
+# endif
@@ -0,0 +1,51 @@
+/*
+ *	workpool.h
+ *
+ *	Includefile for workpool.c
+ */
+
+#ifndef __WORKPOOL_H__
+#define __WORKPOOL_H__
+
+#include "vlARGS.h"
+#include "outbuf.h"
+#include "sink.h"
+
+# if defined(__GNUC__) && (defined(__unix__) || defined(__APPLE__)) && !defined(NO_THREADS)
+# define	HAS_THREADS
+# define	THREAD_LOCAL	__thread
+# else
+# define	THREAD_LOCAL
+# endif
+
+/* Status of a task, see wpWrite() */
+# define	wpCONTINUE		0		/* output goes on after the task		*/
+# define	wpSTOP			1		/* output ends with the task			*/
+# define	wpERROR			2		/* output ends with an error			*/
+# define	wpNOMEM			3		/* output ends, not enough memory		*/
+
+/*
+ *	A task, the tasks are kept in the order of their output
+ */
+typedef struct WpTask {
+	struct WpTask	*next;		/* next task in output order			*/
+	int				 kind;		/* what to do, for the task function	*/
+	long			 arg[4];
+	OutBuf			 out;		/* output of the task					*/
+	int				 status;	/* wpCONTINUE, wpSTOP or wpERROR		*/
+	int				 done;
+} WpTask;
+
+typedef struct WorkPool WorkPool;
+
+typedef void	(*TaskFunc) (WorkPool *, WpTask *);
+
+EXTERN WorkPool	*wpCreate (int, TaskFunc);
+EXTERN WpTask	*wpSpawn (WorkPool *, WpTask *, int, long, long, long, long);
+EXTERN int		 wpPush (WorkPool *, WpTask *);
+EXTERN void		 wpCancel (WorkPool *, WpTask *);
+EXTERN int		 wpWrite (WorkPool *, Sink *, long);
+EXTERN void		 wpDestroy (WorkPool *);
+EXTERN int		 wpThreadStats (WorkPool *, int, long *, long *, double *);
+
+#endif